@@ -0,0 +1,192 @@
+/*
+ * animation.c
+ *
+ * Author: Alex Patapan
+ *
+ * Each animation type has a script in program memory - the cells it 
+ * covers (relative to its position) and a list of frames, each a 
+ * colour and the number of steps it is shown for. animation_compose()
+ * only writes the covered cells, and because the LED matrix frame is
+ * only sent where it has changed, a frame only costs the cells whose
+ * colour actually changed.
+ */
+
+#include <avr/pgmspace.h>
+
+#include "animation.h"
+#include "game.h"
+#include "ledmatrix.h"
+#include "pixel_colour.h"
+#include "memory.h"
+
+typedef struct {
+	PixelColour colour;
+	uint8_t steps;
+} AnimationFrame;
+
+// A frame with no steps ends a script
+#define END_OF_SCRIPT { COLOUR_BLACK, 0 }
+
+// The cells an animation covers in the game row dy rows above (or
+// below, if negative) its centre, for each column the centre may be
+// in. Bit x of masks[centreX] is set if column x is covered. The masks
+// are already clipped to the game field.
+typedef struct {
+	int8_t dy;
+	uint8_t masks[FIELD_WIDTH];
+} StencilRow;
+
+typedef struct {
+	const StencilRow* stencil;
+	uint8_t stencilRows;
+	const AnimationFrame* frames;
+	uint8_t drawsBase;	// 1 if the animation may be drawn over the base
+} AnimationScript;
+
+// The centre cell and the cells either side, above and below
+#define PLUS_ROWS 3
+static const StencilRow plus_stencil[PLUS_ROWS] PROGMEM = {
+	{ 0, { 0x03, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xC0 } },
+	{ 1, { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 } },
+	{ -1, { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 } } };
+
+// Centred on the tip of the base station - the tip and the cells 
+// either side and above it, and the row below (the base's footprint)
+#define BASE_ROWS 3
+static const StencilRow base_stencil[BASE_ROWS] PROGMEM = {
+	{ 0, { 0x03, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xC0 } },
+	{ 1, { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 } },
+	{ -1, { 0x03, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xC0 } } };
+
+static const AnimationFrame explosion_frames[] PROGMEM = {
+	{ COLOUR_ORANGE, 2 }, { COLOUR_LIGHT_ORANGE, 2 }, { COLOUR_ORANGE, 2 },
+	END_OF_SCRIPT };
+static const AnimationFrame base_hit_frames[] PROGMEM = {
+	{ COLOUR_RED, 2 }, { COLOUR_ORANGE, 2 }, { COLOUR_RED, 2 }, 
+	{ COLOUR_LIGHT_ORANGE, 2 }, END_OF_SCRIPT };
+
+static const AnimationScript scripts[NUM_ANIMATION_TYPES] PROGMEM = {
+	{ plus_stencil, PLUS_ROWS, explosion_frames, 0 },
+	{ base_stencil, BASE_ROWS, base_hit_frames, 1 } };
+
+typedef struct {
+	const AnimationScript* script;
+	const AnimationFrame* frame;	// 0 if the slot is free
+	uint8_t stepsLeft;		// in the current frame
+	uint8_t totalStepsLeft;	// in the whole animation
+	uint8_t x;
+	uint8_t y;
+} Animation;
+
+static Animation animations[MAX_ANIMATIONS];
+
+// Static data used by this module (see memory.h)
+MEMORY_USAGE(animation, sizeof(animations), sizeof(plus_stencil) + 
+		sizeof(base_stencil) + sizeof(explosion_frames) + sizeof(base_hit_frames) +
+		sizeof(scripts));
+
+static void draw_cells(Animation* animation, int8_t restore);
+
+void init_animations(void) {
+	for(uint8_t i = 0; i < MAX_ANIMATIONS; i++) {
+		animations[i].frame = 0;
+	}
+}
+
+void animation_start(AnimationType type, uint8_t x, uint8_t y) {
+	Animation* animation = 0;
+	const AnimationFrame* frame;
+	uint8_t leastLeft = 255;
+	
+	// Use a free slot if there is one, otherwise take over the 
+	// animation closest to finishing (putting its cells back first)
+	for(uint8_t i = 0; i < MAX_ANIMATIONS; i++) {
+		if(!animations[i].frame) {
+			animation = &animations[i];
+			break;
+		}
+		if(animations[i].totalStepsLeft < leastLeft) {
+			leastLeft = animations[i].totalStepsLeft;
+			animation = &animations[i];
+		}
+	}
+	if(animation->frame) {
+		draw_cells(animation, 1);
+	}
+	
+	animation->script = &scripts[type];
+	animation->frame = (const AnimationFrame*)pgm_read_word(&scripts[type].frames);
+	animation->stepsLeft = pgm_read_byte(&animation->frame->steps);
+	animation->totalStepsLeft = 0;
+	for(frame = animation->frame; pgm_read_byte(&frame->steps); frame++) {
+		animation->totalStepsLeft += pgm_read_byte(&frame->steps);
+	}
+	animation->x = x;
+	animation->y = y;
+}
+
+void animation_step(void) {
+	Animation* animation;
+	
+	for(uint8_t i = 0; i < MAX_ANIMATIONS; i++) {
+		animation = &animations[i];
+		if(!animation->frame) {
+			continue;
+		}
+		animation->totalStepsLeft--;
+		if(--animation->stepsLeft) {
+			continue;
+		}
+		animation->frame++;
+		animation->stepsLeft = pgm_read_byte(&animation->frame->steps);
+		if(animation->stepsLeft == 0) {
+			// Finished - show the game again
+			draw_cells(animation, 1);
+			animation->frame = 0;
+		}
+	}
+}
+
+void animation_compose(void) {
+	for(uint8_t i = 0; i < MAX_ANIMATIONS; i++) {
+		if(animations[i].frame) {
+			draw_cells(&animations[i], 0);
+		}
+	}
+}
+
+// Draw the cells covered by the animation in its current colour, or
+// if restore is true, in the game's colour
+static void draw_cells(Animation* animation, int8_t restore) {
+	const StencilRow* row = 
+			(const StencilRow*)pgm_read_word(&animation->script->stencil);
+	uint8_t numRows = pgm_read_byte(&animation->script->stencilRows);
+	uint8_t drawsBase = pgm_read_byte(&animation->script->drawsBase);
+	PixelColour colour = pgm_read_byte(&animation->frame->colour);
+	uint8_t x, y, mask;
+	int8_t dy;
+	
+	for(uint8_t i = 0; i < numRows; i++, row++) {
+		dy = (int8_t)pgm_read_byte(&row->dy);
+		y = animation->y + dy;
+		if(y >= FIELD_HEIGHT) {
+			// Off the top or (wrapped around) the bottom of the field
+			continue;
+		}
+		mask = pgm_read_byte(&row->masks[animation->x]);
+		if(!drawsBase) {
+			// Leave the base station showing
+			mask &= ~base_cells(y);
+		}
+		for(x = 0; mask; x++, mask >>= 1) {
+			if(!(mask & 1)) {
+				continue;
+			}
+			if(restore) {
+				colour = game_cell_colour(x, y);
+			}
+			ledmatrix_update_pixel_at(GAME_POSITION_ADDRESS(GAME_POSITION(x, y)), 
+					colour);
+		}
+	}
+}
@@ -0,0 +1,46 @@
+/*
+ * animation.h
+ *
+ * Author: Alex Patapan
+ *
+ * Short animations (e.g. explosions) drawn over the game field. Up to
+ * MAX_ANIMATIONS can play at once. Each animation covers a few cells 
+ * around a game position and steps through a sequence of colours. 
+ * Cells are returned to whatever the game shows there when the 
+ * animation finishes.
+ */
+
+#ifndef ANIMATION_H_
+#define ANIMATION_H_
+
+#include <stdint.h>
+
+#define MAX_ANIMATIONS 4
+
+// Time (ms) between animation steps - animation_step() should be 
+// called this often
+#define ANIMATION_STEP_PERIOD 10
+
+typedef enum {
+	ANIMATION_EXPLOSION,	// asteroid destroyed
+	ANIMATION_BASE_HIT,		// base station hit by an asteroid
+	NUM_ANIMATION_TYPES
+} AnimationType;
+
+// Stop all animations (without redrawing anything)
+void init_animations(void);
+
+// Start an animation at the given game position (x 0 to 7, y 0 to 15).
+// If all MAX_ANIMATIONS are playing, the one closest to finishing is 
+// stopped to make room.
+void animation_start(AnimationType type, uint8_t x, uint8_t y);
+
+// Move the animations on by one step
+void animation_step(void);
+
+// Draw the animations over the game in the LED matrix frame. This 
+// should be done before every ledmatrix_flush() so that the game's 
+// updates don't hide the animations.
+void animation_compose(void);
+
+#endif /* ANIMATION_H_ */
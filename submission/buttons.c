@@ -7,21 +7,33 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include "buttons.h"
+#include "timer0.h"
+#include "memory.h"
 
 // Global variable to keep track of the last button state so that we 
 // can detect changes when an interrupt fires. The lower 4 bits (0 to 3)
 // will correspond to the last state of port B pins 0 to 3.
 static volatile uint8_t last_button_state;
 
-// Our button queue. button_queue[0] is always the head of the queue. If we
-// take something off the queue we just move everything else along. We don't
-// use a circular buffer since it is usually expected that the queue is very
-// short. In most uses it will never have more than 1 element at a time.
-// This button queue can be changed by the interrupt handler below so we should
-// turn off interrupts if we're changing the queue outside the handler.
-#define BUTTON_QUEUE_SIZE 4
-static volatile uint8_t button_queue[BUTTON_QUEUE_SIZE];
-static volatile int8_t queue_length;
+// Our button queue. This is a circular buffer - the interrupt handler
+// below adds events at queue_head and button_event() removes them from
+// queue_tail. Each index is only ever changed by one side (and is a 
+// single byte, so is read and written in one go) so neither side needs
+// to turn interrupts off. The indices count up continuously (wrapping 
+// at 256) and the number of events in the queue is 
+// (queue_head - queue_tail). BUTTON_QUEUE_SIZE must be a power of two.
+#define BUTTON_QUEUE_SIZE 8
+#define BUTTON_QUEUE_MASK (BUTTON_QUEUE_SIZE - 1)
+static volatile ButtonEvent button_queue[BUTTON_QUEUE_SIZE];
+static volatile uint8_t queue_head;
+static volatile uint8_t queue_tail;
+
+// Number of button pushes discarded because the queue was full
+static volatile uint16_t queue_overflows;
+
+// Static data used by this module (see memory.h)
+MEMORY_USAGE(buttons, sizeof(last_button_state) + sizeof(button_queue) +
+		sizeof(queue_head) + sizeof(queue_tail) + sizeof(queue_overflows), 0);
 
 // Setup interrupt if any of pins B0 to B3 change. We do this
 // using a pin change interrupt. These pins correspond to pin
@@ -40,33 +52,45 @@ void init_button_interrupts(void) {
 	PCMSK1 |= (1<<PCINT8)|(1<<PCINT9)|(1<<PCINT10)|(1<<PCINT11);	
 	
 	// Empty the button push queue
-	queue_length = 0;
+	queue_head = queue_tail = 0;
+	queue_overflows = 0;
+}
+
+int8_t button_event(ButtonEvent* event) {
+	uint8_t tail = queue_tail;
+	
+	if(queue_head == tail) {
+		return 0;
+	}
+	// Copy the event out before moving the tail on - once the tail 
+	// moves the interrupt handler may reuse the entry.
+	event->button = button_queue[tail & BUTTON_QUEUE_MASK].button;
+	event->time = button_queue[tail & BUTTON_QUEUE_MASK].time;
+	queue_tail = tail + 1;
+	return 1;
 }
 
 int8_t button_pushed(void) {
-	int8_t return_value = NO_BUTTON_PUSHED;	// Assume no button pushed
-	if(queue_length > 0) {
-		// Remove the first element off the queue and move all the other
-		// entries closer to the front of the queue. We turn off interrupts (if on)
-		// before we make any changes to the queue. If interrupts were on
-		// we turn them back on when done.
-		return_value = button_queue[0];
-		
-		// Save whether interrupts were enabled and turn them off
-		int8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
-		cli();
-		
-		for(uint8_t i = 1; i < queue_length; i++) {
-			button_queue[i-1] = button_queue[i];
-		}
-		queue_length--;
-		
-		if(interrupts_were_enabled) {
-			// Turn them back on again
-			sei();
-		}
+	ButtonEvent event;
+	
+	if(button_event(&event)) {
+		return event.button;
 	}
-	return return_value;
+	return NO_BUTTON_PUSHED;
+}
+
+uint16_t button_queue_overflows(void) {
+	uint16_t overflows;
+	
+	// The count is two bytes so make sure the interrupt handler
+	// doesn't change it while we're reading it
+	int8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	overflows = queue_overflows;
+	if(interrupts_were_enabled) {
+		sei();
+	}
+	return overflows;
 }
 
 // Interrupt handler for a change on buttons
@@ -77,16 +101,24 @@ ISR(PCINT1_vect) {
 	
 	// Iterate over all the buttons and see which ones have changed.
 	// Any button pushes are added to the queue of button pushes (if
-	// there is space). We ignore button releases so we're just looking
-	// for a transition from 0 in the last_button_state bit to a 1 in the 
-	// button_state.
+	// there is space - otherwise they are counted as overflows). We 
+	// ignore button releases so we're just looking for a transition 
+	// from 0 in the last_button_state bit to a 1 in the button_state.
+	uint8_t pushed = button_state & ~last_button_state;
+	uint32_t current_time = 0;
+	if(pushed) {
+		current_time = get_current_time();
+	}
 	for(uint8_t pin=0; pin<=3; pin++) {
-		if(queue_length < BUTTON_QUEUE_SIZE && 
-				(button_state & (1<<pin)) && 
-				!(last_button_state & (1<<pin))) {
-			// Add the button push to the queue (and update the
-			// length of the queue
-			button_queue[queue_length++] = pin;
+		if(pushed & (1<<pin)) {
+			uint8_t head = queue_head;
+			if((uint8_t)(head - queue_tail) < BUTTON_QUEUE_SIZE) {
+				button_queue[head & BUTTON_QUEUE_MASK].button = pin;
+				button_queue[head & BUTTON_QUEUE_MASK].time = current_time;
+				queue_head = head + 1;
+			} else {
+				queue_overflows++;
+			}
 		}
 	}
 	
@@ -21,14 +21,32 @@
  */
 void init_button_interrupts(void);
 
-/* Return the last button pushed (0 to 3) or -1 (NO_BUTTON_PUSHED) if 
- * there are no button pushes to return. (A small queue of button pushes
- * is kept. This function should be called frequently enough to
- * ensure the queue does not overflow. Excess button pushes are
- * discarded.)
+/* A button push - the button (0 to 3) and the time at which it was 
+ * pushed (see get_current_time())
+ */
+typedef struct {
+	uint8_t button;
+	uint32_t time;
+} ButtonEvent;
+
+/* Remove the oldest button push from the queue and copy it into event.
+ * Returns 1 if there was a button push, 0 if the queue was empty. (A 
+ * small queue of button pushes is kept. This function should be called
+ * frequently enough to ensure the queue does not overflow. Excess 
+ * button pushes are discarded - see button_queue_overflows().)
  */
+int8_t button_event(ButtonEvent* event);
 
+/* Return the last button pushed (0 to 3) or -1 (NO_BUTTON_PUSHED) if 
+ * there are no button pushes to return. (As per button_event() but 
+ * without the time.)
+ */
 int8_t button_pushed(void);
 
+/* Return the number of button pushes which have been discarded because
+ * the queue was full.
+ */
+uint16_t button_queue_overflows(void);
+
 
 #endif /* BUTTONS_H_ */
\ No newline at end of file
@@ -0,0 +1,50 @@
+/*
+ * entity_pool.c
+ *
+ * Author: Alex Patapan
+ *
+ * See entity_pool.h. The pool only records positions - the occupancy
+ * bitboards in game.c are kept up to date by the caller.
+ */
+
+#include "entity_pool.h"
+
+void pool_init(EntityPool* pool, GamePosition* positions, uint8_t capacity) {
+	pool->positions = positions;
+	pool->capacity = capacity;
+	pool->count = 0;
+}
+
+void pool_clear(EntityPool* pool) {
+	pool->count = 0;
+}
+
+int8_t pool_add(EntityPool* pool, GamePosition position) {
+	if(pool->count >= pool->capacity) {
+		return POOL_NO_SLOT;
+	}
+	pool->positions[pool->count] = position;
+	return pool->count++;
+}
+
+void pool_remove(EntityPool* pool, int8_t slot) {
+	if(slot < 0 || slot >= pool->count) {
+		return;
+	}
+	// Fill the gap with the last live entity (if this wasn't it)
+	pool->count--;
+	pool->positions[slot] = pool->positions[pool->count];
+}
+
+int8_t pool_find(const EntityPool* pool, GamePosition position) {
+	for(uint8_t i = 0; i < pool->count; i++) {
+		if(pool->positions[i] == position) {
+			return i;
+		}
+	}
+	return POOL_NO_SLOT;
+}
+
+uint8_t pool_is_full(const EntityPool* pool) {
+	return pool->count >= pool->capacity;
+}
@@ -0,0 +1,53 @@
+/*
+ * entity_pool.h
+ *
+ * Author: Alex Patapan
+ *
+ * Fixed capacity pool of game entities (asteroids, projectiles). The
+ * positions of the live entities are kept packed at the start of the
+ * positions array - slots 0 to count - 1 are live and the rest are 
+ * free - so iterating over the pool only visits live entities and 
+ * removing an entity is O(1): the last live entity is moved into the 
+ * freed slot. This means slot numbers are only stable until the next 
+ * removal. Loops which may remove the current entity should run from
+ * the last slot down to 0 - every entity is then visited exactly once.
+ */
+
+#ifndef ENTITY_POOL_H_
+#define ENTITY_POOL_H_
+
+#include <stdint.h>
+#include "game.h"
+
+// Returned by pool_add() and pool_find() when there is no slot
+#define POOL_NO_SLOT	-1
+
+typedef struct {
+	GamePosition* positions;	// Packed positions of the live entities
+	uint8_t count;			// Number of live entities
+	uint8_t capacity;		// Size of the positions array
+} EntityPool;
+
+// Connect the pool to its (caller allocated) array of positions and 
+// empty it
+void pool_init(EntityPool* pool, GamePosition* positions, uint8_t capacity);
+
+// Remove all entities from the pool
+void pool_clear(EntityPool* pool);
+
+// Add an entity at the given position. Returns the slot it was added
+// in or POOL_NO_SLOT if the pool is full.
+int8_t pool_add(EntityPool* pool, GamePosition position);
+
+// Remove the entity in the given slot. Invalid slots (including 
+// POOL_NO_SLOT) are ignored.
+void pool_remove(EntityPool* pool, int8_t slot);
+
+// Return the slot of the entity at the given position or POOL_NO_SLOT
+// if there is none
+int8_t pool_find(const EntityPool* pool, GamePosition position);
+
+// Returns 1 if no more entities can be added, 0 otherwise
+uint8_t pool_is_full(const EntityPool* pool);
+
+#endif /* ENTITY_POOL_H_ */
@@ -10,12 +10,17 @@
 #include "pixel_colour.h"
 #include "score.h"
 #include "terminalio.h"
-#include "time.h"
+#include "terminal_status.h"
+#include "telemetry.h"
+#include "profiler.h"
+#include "sound.h"
+#include "animation.h"
+#include "intmath.h"
+#include "prng.h"
+#include "entity_pool.h"
+#include "memory.h"
 #include <avr/pgmspace.h>
-#include <stdlib.h>
 #include <stdio.h>
-#include <math.h>
-/* Stdlib needed for random() - random number generator */
 
 ///////////////////////////////////////////////////////////
 // Colours
@@ -24,32 +29,73 @@
 #define COLOUR_BASE			COLOUR_YELLOW
 
 ///////////////////////////////////////////////////////////
-// Game positions (x,y) where x is 0 to 7 and y is 0 to 15
-// are represented in a single 8 bit unsigned integer where the most
-// significant 4 bits are the x value and the least significant 4 bits
-// are the y value. The following macros allow the extraction of x and y
-// values from a combined position value and the construction of a combined 
-// position value from separate x, y values. Values are assumed to be in
-// valid ranges. Invalid positions are any where the least significant
-// bit is 1 (i.e. x value greater than 7). We can use all 1's (255) to 
-// represent this.
-#define GAME_POSITION(x,y)		( ((x) << 4)|((y) & 0x0F) )
-#define GET_X_POSITION(posn)	((posn) >> 4)
-#define GET_Y_POSITION(posn)	((posn) & 0x0F)
-#define INVALID_POSITION		255
+// Occupancy bitboards. Each entry of an occupancy array is one row of
+// the game field (indexed by y) and bit x of that entry is set if the
+// position (x,y) is occupied. The following macros set and clear the
+// bit corresponding to a combined position value.
+#define SET_OCCUPIED(rows, posn)	\
+		((rows)[GET_Y_POSITION(posn)] |= (1 << GET_X_POSITION(posn)))
+#define CLEAR_OCCUPIED(rows, posn)	\
+		((rows)[GET_Y_POSITION(posn)] &= ~(1 << GET_X_POSITION(posn)))
 
 ///////////////////////////////////////////////////////////
-// Macros to convert game position to LED matrix position
-// Note that the row number (y value) in the game (0 to 15 from the bottom) 
-// corresponds to x values on the LED matrix (0 to 15).
-// Column numbers (x values) in the game (0 to 7 from the left) correspond
-// to LED matrix y values rom 7 to 0
-//
-// Note that these macros result in two expressions that are comma separated - suitable
-// as use for the first two arguments to ledmatrix_update_pixel().
-#define LED_MATRIX_POSN_FROM_XY(gameX, gameY)		(gameY) , (7-(gameX))
-#define LED_MATRIX_POSN_FROM_GAME_POSN(posn)		\
-		LED_MATRIX_POSN_FROM_XY(GET_X_POSITION(posn), GET_Y_POSITION(posn))
+// Time (ms) between asteroid moves - starts at 500ms and gets 1.8ms 
+// shorter for every point scored
+#define ASTEROID_START_PERIOD	500
+#define ASTEROID_SPEEDUP		Q8(1.8)
+
+///////////////////////////////////////////////////////////
+// Base station footprint in row 0 for each base position from
+// 0 to 7 - the centre position and the positions either side of
+// it (clipped to the game field). Row 1 of the base is just the
+// centre position.
+static const uint8_t baseFootprint[FIELD_WIDTH] PROGMEM = {
+		0x03, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xC0 };
+
+// Number of bits set in each 4 bit value (used to count the asteroids
+// in a row a nibble at a time)
+static const uint8_t nibbleBits[16] PROGMEM = {
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+///////////////////////////////////////////////////////////
+// The field must fit on the LED matrix panels
+#if FIELD_HEIGHT > MATRIX_NUM_COLUMNS || FIELD_WIDTH != MATRIX_NUM_ROWS
+#error "The game field doesn't fit the LED matrix - see MATRIX_NUM_PANELS"
+#endif
+
+///////////////////////////////////////////////////////////
+// LED matrix pixel address of each game position (see game.h). The 
+// row number (y value) in the game (0 to FIELD_HEIGHT - 1 from the 
+// bottom) is the x value on the LED matrix and the column number 
+// (x value) in the game (0 to 7 from the left) is LED matrix y value 
+// 7 to 0. Each game column has 1 << FIELD_Y_BITS entries - those 
+// beyond FIELD_HEIGHT are never used.
+#define ADDRESSES_16(x, y) \
+		MATRIX_ADDRESS((y)+0, 7-(x)), MATRIX_ADDRESS((y)+1, 7-(x)), \
+		MATRIX_ADDRESS((y)+2, 7-(x)), MATRIX_ADDRESS((y)+3, 7-(x)), \
+		MATRIX_ADDRESS((y)+4, 7-(x)), MATRIX_ADDRESS((y)+5, 7-(x)), \
+		MATRIX_ADDRESS((y)+6, 7-(x)), MATRIX_ADDRESS((y)+7, 7-(x)), \
+		MATRIX_ADDRESS((y)+8, 7-(x)), MATRIX_ADDRESS((y)+9, 7-(x)), \
+		MATRIX_ADDRESS((y)+10, 7-(x)), MATRIX_ADDRESS((y)+11, 7-(x)), \
+		MATRIX_ADDRESS((y)+12, 7-(x)), MATRIX_ADDRESS((y)+13, 7-(x)), \
+		MATRIX_ADDRESS((y)+14, 7-(x)), MATRIX_ADDRESS((y)+15, 7-(x))
+#if FIELD_Y_BITS == 4
+#define GAME_COLUMN_ADDRESSES(x)	ADDRESSES_16(x, 0)
+#elif FIELD_Y_BITS == 5
+#define GAME_COLUMN_ADDRESSES(x)	ADDRESSES_16(x, 0), ADDRESSES_16(x, 16)
+#else
+#define GAME_COLUMN_ADDRESSES(x)	ADDRESSES_16(x, 0), ADDRESSES_16(x, 16), \
+		ADDRESSES_16(x, 32), ADDRESSES_16(x, 48)
+#endif
+const MatrixAddress gamePositionAddress[FIELD_POSITIONS] PROGMEM = {
+		GAME_COLUMN_ADDRESSES(0), GAME_COLUMN_ADDRESSES(1), 
+		GAME_COLUMN_ADDRESSES(2), GAME_COLUMN_ADDRESSES(3),
+		GAME_COLUMN_ADDRESSES(4), GAME_COLUMN_ADDRESSES(5),
+		GAME_COLUMN_ADDRESSES(6), GAME_COLUMN_ADDRESSES(7) };
+
+// Draw the given game position in the given colour
+#define DRAW_POSITION(posn, colour)	\
+		ledmatrix_update_pixel_at(GAME_POSITION_ADDRESS(posn), (colour))
 
 ///////////////////////////////////////////////////////////
 // Global variables.
@@ -59,28 +105,48 @@
 // permitted to partially move off the game field so that the centre
 // point can take on any position from 0 to 7 inclusive.
 //
-// numProjectiles - The number of projectiles currently in flight. Must
-// be less than or equal to MAX_PROJECTILES.
+// projectiles - pool of the projectiles that are currently in flight
+// (at most MAX_PROJECTILES). Each position holds the x position in 
+// the upper 4 bits and the y position in the lower 4 bits. Projectile
+// numbers are the pool slots from 0 to projectiles.count - 1 - these
+// change when a projectile is removed (see entity_pool.h).
+//
+// projectileRows - occupancy bitboard for the projectiles. Bit x of
+// projectileRows[y] is set if there is a projectile at (x,y). This is
+// kept in sync with the projectiles pool.
 //
-// projectiles - x,y positions of the projectiles that are currently
-// in flight. The upper 4 bits represent the x position; the lower 4
-// bits represent the y position. The array is indexed by projectile
-// number from 0 to numProjectiles - 1.
+// asteroids - pool of the asteroids on the game field (at most 
+// MAX_ASTEROIDS), with positions stored as for projectiles.
 //
-// numAsteroids - The number of asteroids currently on the game field.
-// Must be less than or equal to MAX_ASTEROIDS.
+// asteroidRows - occupancy bitboard for the asteroids. Bit x of
+// asteroidRows[y] is set if there is an asteroid at (x,y). This is
+// kept in sync with the asteroids pool.
 //
-// asteroids - x,y positions of the asteroids on the field. The upper
-// 4 bits represent the x position; the lower 4 bits represent the 
-// y position. The array is indexed by asteroid number from 0 to 
-// numAsteroids - 1.
+// gameTicks - the number of times the asteroids or projectiles have
+// been advanced since the game started (see game_tick_count()).
+//
+// fieldChanged - set whenever the base, asteroids or projectiles 
+// change. The functions below only change the game state - the field
+// is drawn from it by game_compose(), once per display update, and 
+// only if this is set.
 
 int8_t		basePosition;
-int8_t		numProjectiles;
-uint8_t		projectiles[MAX_PROJECTILES];
-int8_t		numAsteroids;
-uint8_t		asteroids[MAX_ASTEROIDS];
+GamePosition	projectilePositions[MAX_PROJECTILES];
+EntityPool	projectiles;
+FieldRow	projectileRows[FIELD_HEIGHT];
+GamePosition	asteroidPositions[MAX_ASTEROIDS];
+EntityPool	asteroids;
+FieldRow	asteroidRows[FIELD_HEIGHT];
 int			lives;
+uint32_t	gameTicks;
+uint8_t		fieldChanged;
+
+// Static data used by this module (see memory.h)
+MEMORY_USAGE(game, sizeof(basePosition) + sizeof(projectilePositions) + 
+		sizeof(projectiles) + sizeof(projectileRows) + sizeof(asteroidPositions) +
+		sizeof(asteroids) + sizeof(asteroidRows) + sizeof(lives) + 
+		sizeof(gameTicks) + sizeof(fieldChanged), 
+		sizeof(baseFootprint) + sizeof(nibbleBits) + sizeof(gamePositionAddress));
 
 ///////////////////////////////////////////////////////////
 // Prototypes for internal information functions 
@@ -88,12 +154,46 @@ int			lives;
 
 // Is there is an asteroid/projectile at the given position?. 
 // Returns -1 if no, asteroid/projectile index number if yes.
-// (The index number is the array index in the asteroids/
-// projectiles array above.)
+// (The index number is the slot in the asteroids/projectiles
+// pool above.)
 
 static int8_t asteroid_at(uint8_t x, uint8_t y);
 static int8_t projectile_at(uint8_t x, uint8_t y);
 
+// Is there an asteroid/projectile at the given position? Returns
+// non-zero if yes, 0 if no (or if the position is off the game field).
+// These only test the occupancy bitboards so are much cheaper than
+// the functions above when the index number is not needed.
+static uint8_t asteroid_present(uint8_t x, uint8_t y);
+static uint8_t projectile_present(uint8_t x, uint8_t y);
+
+// Destroy the asteroids in the given row (y) whose bits are set in 
+// the hits mask. The asteroids must already have been cleared from
+// the bitboard. The projectiles in those positions are removed.
+static void destroy_asteroids(uint8_t hits, uint8_t y);
+
+// Return the number of asteroids (bits set) in the given mask
+static uint8_t asteroids_in_row(uint8_t rowMask);
+
+// Return the column of the given (0 = first) set bit in the mask.
+// The mask must have more than n bits set.
+static uint8_t select_column(uint8_t mask, uint8_t n);
+
+// Return a random column which is not occupied in the given row 
+// mask - or NO_FREE_COLUMN if the row is full.
+#define NO_FREE_COLUMN	0xFF
+static uint8_t random_free_column(uint8_t rowMask);
+
+// Return a random position without an asteroid in rows firstRow
+// to FIELD_HEIGHT - 1 - or INVALID_POSITION if they are full. Every
+// free position is equally likely.
+static GamePosition random_free_position(uint8_t firstRow);
+
+// Add an asteroid at the given position (which must not already
+// have an asteroid). Returns the asteroid number, or -1 if there
+// are already MAX_ASTEROIDS asteroids.
+static int8_t add_asteroid(uint8_t x, uint8_t y);
+
 // Remove the asteroid/projectile at the given index number. If
 // the index is not valid, then no removal is performed. This 
 // enables the functions to be used like:
@@ -101,13 +201,6 @@ static int8_t projectile_at(uint8_t x, uint8_t y);
 static void remove_asteroid(int8_t asteroidIndex);
 static void remove_projectile(int8_t projectileIndex);
 
-// Redraw functions
-static void redraw_whole_display(void);
-void redraw_base(uint8_t colour);
-void redraw_all_asteroids(void);
-static void redraw_asteroid(uint8_t asteroidNumber, uint8_t colour);
-void redraw_all_projectiles(void);
-static void redraw_projectile(uint8_t projectileNumber, uint8_t colour);
 ///////////////////////////////////////////////////////////
 
 
@@ -117,48 +210,34 @@ static void regen_asteroid(void);
 void update_terminal(void);
 // update led
 void update_led(void);
-// sounds
-void shoot_sound(void);
-void hit_sound(void);
-void enable_basehit_sound(void);
-void handle_asteroid_animation(int x, int y);
-void enable_asteroid_animation(int x, int y);
  
 // Initialise game field:
 // (1) base starts in the centre (x=3)
 // (2) no projectiles initially
 // (3) the maximum number of asteroids, randomly distributed.
 void initialise_game(void) {
-	uint8_t x, y, i;
+	uint8_t y, i;
+	GamePosition position;
 	
     basePosition = 3;
-	numProjectiles = 0;
-	numAsteroids = 0;
+	pool_init(&projectiles, projectilePositions, MAX_PROJECTILES);
+	pool_init(&asteroids, asteroidPositions, MAX_ASTEROIDS);
 	lives = 4;
-	
-	//seed random
-	time_t seconds;
-	srand((unsigned) time(&seconds));
+	gameTicks = 0;
+	for(y=0; y < FIELD_HEIGHT; y++) {
+		projectileRows[y] = 0;
+		asteroidRows[y] = 0;
+	}
 	
 	for(i=0; i < MAX_ASTEROIDS ; i++) {
-		// Generate random position that does not already
-		// have an asteroid.
-		do {
-			// Generate random x position - somewhere from 0
-			// to FIELD_WIDTH - 1
-			x = (uint8_t)(random() % FIELD_WIDTH);
-			// Generate random y position - somewhere from 3
-			// to FIELD_HEIGHT - 1 (i.e., not in the lowest
-			// three rows)
-			y = (uint8_t)(3 + (random() % (FIELD_HEIGHT-3)));
-		} while(asteroid_at(x,y) != -1);
-		// If we get here, we've now found an x,y location without
-		// an existing asteroid - record the position
-		asteroids[i] = GAME_POSITION(x,y);
-		numAsteroids++;
+		// Choose a random position that does not already have
+		// an asteroid - somewhere in rows 3 to FIELD_HEIGHT - 1
+		// (i.e., not in the lowest three rows) - and record it
+		position = random_free_position(3);
+		add_asteroid(GET_X_POSITION(position), GET_Y_POSITION(position));
 	}
 	
-	redraw_whole_display();
+	fieldChanged = 1;
 }
 
 // Attempt to move the base station to the left or right. 
@@ -179,18 +258,15 @@ int8_t move_base(int8_t direction) {
 	// YOUR CODE HERE (AND BELOW) - FIX THIS FUNCTION
 	int success = 0;
 	
-	// We erase the base from its current position first
-	redraw_base(COLOUR_BLACK);
-	
 	// Move the base (only to the left at present)
 	if ((direction == MOVE_LEFT) && (basePosition != 0)) {
-		if (asteroid_at(basePosition-2,0) != -1) {
-			enable_basehit_sound();
+		if (asteroid_present(basePosition-2,0)) {
+			sound_trigger(SOUND_BASEHIT);
 			lives = lives - 1;
 			remove_asteroid(asteroid_at(basePosition-2,0));
 		} 
-		if (asteroid_at(basePosition-1,1) != -1) {
-			enable_basehit_sound();
+		if (asteroid_present(basePosition-1,1)) {
+			sound_trigger(SOUND_BASEHIT);
 			lives = lives - 1;
 			remove_asteroid(asteroid_at(basePosition-1,1));
 		}
@@ -199,13 +275,13 @@ int8_t move_base(int8_t direction) {
 		success = 1;	
 			
 	} else if ((direction == MOVE_RIGHT) && (basePosition != 7)){
-		if (asteroid_at(basePosition+2,0) != -1) {
-			enable_basehit_sound();
+		if (asteroid_present(basePosition+2,0)) {
+			sound_trigger(SOUND_BASEHIT);
 			lives = lives - 1;
 			remove_asteroid(asteroid_at(basePosition+2,0));
 		}
-		if (asteroid_at(basePosition+1,1) != -1) {
-			enable_basehit_sound();
+		if (asteroid_present(basePosition+1,1)) {
+			sound_trigger(SOUND_BASEHIT);
 			lives = lives - 1;
 			remove_asteroid(asteroid_at(basePosition+1,1));
 		}
@@ -213,8 +289,9 @@ int8_t move_base(int8_t direction) {
 		success = 1;
 	}
 	update_terminal();
-	// Redraw the base
-	redraw_base(COLOUR_BASE);
+	if(success) {
+		fieldChanged = 1;
+	}
 	
 	return 0+success;
 }
@@ -225,23 +302,24 @@ int8_t move_base(int8_t direction) {
 // we can have in flight (to MAX_PROJECTILES).
 // Returns 1 if projectile fired, 0 otherwise.
 int8_t fire_projectile(void) {
-	uint8_t newProjectileNumber;
-	if(numProjectiles < MAX_PROJECTILES && 
-			projectile_at(basePosition, 2) == -1) {
+	int8_t newProjectileNumber;
+	if(!pool_is_full(&projectiles) && 
+			!projectile_present(basePosition, 2)) {
 		// Have space to add projectile - add it at the x position of
 		// the base, in row 2(y=2)
-		shoot_sound();
+		sound_trigger(SOUND_SHOOT);
 		
-		if (asteroid_at(basePosition, 2) != -1) {
+		if (asteroid_present(basePosition, 2)) {
 			remove_asteroid(asteroid_at(basePosition,2));
 			regen_asteroid();
-			hit_sound();
+			sound_trigger(SOUND_HIT);
 			add_to_score(1);
-			enable_asteroid_animation(basePosition, 2);
+			animation_start(ANIMATION_EXPLOSION, basePosition, 2);
 		} else {
-			newProjectileNumber = numProjectiles++;
-			projectiles[newProjectileNumber] = GAME_POSITION(basePosition, 2);
-			redraw_projectile(newProjectileNumber, COLOUR_PROJECTILE);
+			newProjectileNumber = pool_add(&projectiles, 
+					GAME_POSITION(basePosition, 2));
+			SET_OCCUPIED(projectileRows, projectiles.positions[newProjectileNumber]);
+			fieldChanged = 1;
 		}
 		return 1;
 	} else {
@@ -250,120 +328,137 @@ int8_t fire_projectile(void) {
 }
 
 // Move asteroids down by one position, and remove those that have
-// gone off the bottom
+// gone off the bottom. The whole field is advanced at once using the
+// occupancy bitboards - each row of asteroids is tested against the
+// projectiles in the same row and the row below (a projectile
+// there means the asteroid is destroyed) and against the base
+// station footprint before being shifted down a row. Asteroids that
+// drop off the bottom and those that were destroyed are regenerated
+// in the top row.
 void advance_asteroids(void) {
-	for (int x=0; x < 8; x++){
-		for (int y=0; y < 16; y++) {
-			if (asteroid_at(x,y) != -1) {
-				// we have coordinates of an asteroid
-				remove_asteroid(asteroid_at(x,y));
-				// check if there is a projectile on current tile or next tile
-				if (projectile_at(x,y) != -1) {
-					// hit!
-					hit_sound();
-					remove_projectile(projectile_at(x,y));
-					add_to_score(1);
-					regen_asteroid();
-					enable_asteroid_animation(x, y);
-					
-					
-				} else if (projectile_at(x,y-1) != -1) {
-					// hit!
-					hit_sound();
-					remove_projectile(projectile_at(x,y-1));
-					add_to_score(1);
-					regen_asteroid();
-					enable_asteroid_animation(x,y-1);
-				} else if ((basePosition == x  && y == 2) || (basePosition == x+1 && y == 1) || (basePosition == x-1 && y==1) ) {
-					// check if collision with base
-					lives = lives-1;
-					enable_basehit_sound();
-					regen_asteroid();
-				} else {
-					//move the asteroid
-					numAsteroids++;
-					if (y != 0) {
-						asteroids[numAsteroids-1] = GAME_POSITION(x,y-1);	
-					} else {
-						//asteroid is at bottom of screen
-						uint8_t new_x;
-						do {
-							new_x = (uint8_t)(random() % FIELD_WIDTH);
-						} while (asteroid_at(new_x,15) != -1);
-						
-						asteroids[numAsteroids-1] = GAME_POSITION(new_x,15);
-					}
-					redraw_asteroid(numAsteroids-1, COLOUR_ASTEROID);
-					redraw_base(COLOUR_BASE);
-				}	 
-			
-			}
+	FieldRow previousRow, row, hits, bit;
+	uint8_t x, y;
+	uint8_t numToRegen = 0;
+	uint8_t numDestroyed = 0;
+	uint8_t numBaseHits = 0;
+	
+	PROF_BEGIN(PROF_ADVANCE_ASTEROIDS);
+	gameTicks++;
+	for(y=0; y < FIELD_HEIGHT; y++) {
+		row = asteroidRows[y];
+		previousRow = row;
+		
+		// Asteroids which collide with a projectile in the same
+		// position or the position immediately below
+		hits = row & projectileRows[y];
+		row &= ~hits;
+		destroy_asteroids(hits, y);
+		if(y > 0) {
+			hits = row & projectileRows[y-1];
+			row &= ~hits;
+			destroy_asteroids(hits, y-1);
 		}
+		numDestroyed += asteroids_in_row(previousRow & ~row);
 		
+		// Asteroids which would move into the base station
+		if(y == 1) {
+			hits = row & pgm_read_byte(&baseFootprint[basePosition]);
+		} else if(y == 2) {
+			hits = row & (1 << basePosition);
+		} else {
+			hits = 0;
+		}
+		if(hits) {
+			row &= ~hits;
+			numBaseHits += asteroids_in_row(hits);
+		}
+		
+		// Shift the remaining asteroids down a row. Those in the bottom 
+		// row wrap around to the top.
+		if(y > 0) {
+			asteroidRows[y-1] = row;
+		} else {
+			numToRegen += asteroids_in_row(row);
+		}
+	}
+	asteroidRows[FIELD_HEIGHT-1] = 0;
+	
+	if(numBaseHits) {
+		lives = lives - numBaseHits;
+		sound_trigger(SOUND_BASEHIT);
+		animation_start(ANIMATION_BASE_HIT, basePosition, 1);
+	}
+	numToRegen += numDestroyed + numBaseHits;
+	
+	// Regenerate the asteroids we've lost in the top row
+	while(numToRegen--) {
+		x = random_free_column(asteroidRows[FIELD_HEIGHT-1]);
+		if(x != NO_FREE_COLUMN) {
+			asteroidRows[FIELD_HEIGHT-1] |= (1 << x);
+		}
 	}
+	
+	// Rebuild the asteroids pool from the bitboard
+	pool_clear(&asteroids);
+	for(y=0; y < FIELD_HEIGHT; y++) {
+		row = asteroidRows[y];
+		for(x=0, bit=1; x < FIELD_WIDTH; x++, bit <<= 1) {
+			if(row & bit) {
+				pool_add(&asteroids, GAME_POSITION(x,y));
+			}
+		}
+	}
+	fieldChanged = 1;
+	if(numDestroyed || numBaseHits) {
+		update_terminal();
+	}
+	PROF_END(PROF_ADVANCE_ASTEROIDS);
 }
 
 // Move projectiles up by one position, and remove those that 
-// have gone off the top or that hit an asteroid.
+// have gone off the top or that hit an asteroid. All of the
+// projectiles are taken off the bitboard first, so that a projectile 
+// moving into the position another has just left is not cleared by 
+// it, whatever order they are in the pool.
 void advance_projectiles(void) {
 	uint8_t x, y;
 	int8_t projectileNumber;
 
-	projectileNumber = 0;
-	while(projectileNumber < numProjectiles) {
-		// Get the current position of the projectile
-		x = GET_X_POSITION(projectiles[projectileNumber]);
-		y = GET_Y_POSITION(projectiles[projectileNumber]);
-		
-		// Work out the new position (but don't update the projectile 
-		// location yet - we only do that if we know the move is valid)
-		y = y+1;
+	PROF_BEGIN(PROF_ADVANCE_PROJECTILES);
+	gameTicks++;
+	for(projectileNumber = projectiles.count - 1; projectileNumber >= 0; 
+			projectileNumber--) {
+		CLEAR_OCCUPIED(projectileRows, projectiles.positions[projectileNumber]);
+	}
+	fieldChanged = 1;
+	
+	// Work down from the last projectile so that removing one (which
+	// moves the last projectile into its slot) doesn't skip any
+	for(projectileNumber = projectiles.count - 1; projectileNumber >= 0; 
+			projectileNumber--) {
+		// Get the current position of the projectile and work out
+		// the new position
+		x = GET_X_POSITION(projectiles.positions[projectileNumber]);
+		y = GET_Y_POSITION(projectiles.positions[projectileNumber]) + 1;
 		
-		// Check if new position would be off the top of the display
 		if(y == FIELD_HEIGHT) {
-			// Yes - remove the projectile. (Note that we haven't updated
-			// the position of the projectile itself - so the projectile 
-			// will be removed from its old location.)
-			remove_projectile(projectileNumber);
-			// Note - we do not increment the projectileNumber here as
-			// the remove_projectile() function moves the later projectiles
-			// (if any) back down the list of projectiles so that
-			// the projectileNumber is now the next projectile to be
-			// dealt with (if we weren't at the last one in the list).
-			// remove_projectile() will also result in numProjectiles being
-			// decreased by 1
+			// Gone off the top of the display - remove the projectile
+			pool_remove(&projectiles, projectileNumber);
+		} else if(asteroid_present(x,y)) {
+			// Hit an asteroid - remove the projectile and the asteroid
+			pool_remove(&projectiles, projectileNumber);
+			remove_asteroid(asteroid_at(x,y));
+			sound_trigger(SOUND_HIT);
+			add_to_score(1);
+			regen_asteroid();
+			animation_start(ANIMATION_EXPLOSION, x, y);
 		} else {
-			// Projectile is not going off the top of the display
-			// CHECK HERE IF THE NEW PROJECTILE LOCATION CORRESPONDS TO
-			// AN ASTEROID LOCATION. IF IT DOES, REMOVE THE PROJECTILE
-			// AND THE ASTEROID.
-			if (asteroid_at(x,y) != -1) {
-				remove_projectile(projectileNumber);
-				remove_asteroid(asteroid_at(x,y));
-				hit_sound();
-				add_to_score(1);
-				regen_asteroid();
-				enable_asteroid_animation(x,y);
-				
-			} else {
-			// OTHERWISE...
-			
-			// Remove the projectile from the display 
-			redraw_projectile(projectileNumber, COLOUR_BLACK);
-			
 			// Update the projectile's position
-			projectiles[projectileNumber] = GAME_POSITION(x,y);
-			
-			// Redraw the projectile
-			redraw_projectile(projectileNumber, COLOUR_PROJECTILE);
-			
-			// Move on to the next projectile (we don't do this if a projectile
-			// is removed since projectiles will be shuffled in the list and the
-			// next projectile (if any) will take on the same projectile number)
-			projectileNumber++;
-			}
-		}			
+			projectiles.positions[projectileNumber] = GAME_POSITION(x,y);
+			SET_OCCUPIED(projectileRows, projectiles.positions[projectileNumber]);
+		}
 	}
+	PROF_END(PROF_ADVANCE_PROJECTILES);
 }
 
 void regen_asteroid(void) {
@@ -371,19 +466,12 @@ void regen_asteroid(void) {
 	
 	update_terminal();
 	
-	uint8_t new_x;
-	
-	do {
-		// Generate random x position - somewhere from 0
-		// to FIELD_WIDTH - 1
-		new_x = (uint8_t)(random() % FIELD_WIDTH);
-		
-	} while(asteroid_at(new_x, 15) != -1);
-	// If we get here, we've now found an x,y location without
-	// an existing asteroid - record the position
-	numAsteroids++;
-	asteroids[numAsteroids-1] = GAME_POSITION(new_x,15);
-	redraw_asteroid(numAsteroids-1, COLOUR_ASTEROID);
+	// Find a random x position in the top row without an
+	// existing asteroid - and record the position
+	uint8_t new_x = random_free_column(asteroidRows[FIELD_HEIGHT-1]);
+	if(new_x != NO_FREE_COLUMN) {
+		add_asteroid(new_x, FIELD_HEIGHT-1);
+	}
 }
 
 void update_led(void) {
@@ -400,22 +488,53 @@ void update_led(void) {
 	}
 }
 
+// Record the current score and lives for display. They are output
+// to the terminal the next time terminal_status_flush() is called
+// (and sent as telemetry by telemetry_flush()).
 void update_terminal(void) {
-	clear_terminal();
-	if (get_score() == 0) {
-		move_cursor(11,12);
-	} else {
-		move_cursor(12-ceil(log10(get_score()+1)),12);	
-	}
-	
-	printf_P(PSTR("Score: %lu"), get_score());
-	move_cursor(10,13);
-	printf_P(PSTR("Lives: %i"), lives);
-	hide_cursor();
+	terminal_status_set_score(get_score());
+	terminal_status_set_lives(lives);
+	telemetry_set_score(get_score());
+	telemetry_set_lives(lives);
+	telemetry_set_period(asteroid_period());
 	update_led();
 }
 
 
+// Time (ms) to wait between asteroid moves at the current score
+uint16_t asteroid_period(void) {
+	uint32_t speedup = q8_multiply(get_score(), ASTEROID_SPEEDUP);
+	if(speedup >= ASTEROID_START_PERIOD) {
+		return 0;
+	}
+	return ASTEROID_START_PERIOD - speedup;
+}
+
+// An asteroid is drawn over a projectile, which is drawn over the base
+PixelColour game_cell_colour(uint8_t x, uint8_t y) {
+	if(asteroid_present(x, y)) {
+		return COLOUR_ASTEROID;
+	} else if(projectile_present(x, y)) {
+		return COLOUR_PROJECTILE;
+	} else if(base_cells(y) & (1 << x)) {
+		return COLOUR_BASE;
+	}
+	return COLOUR_BLACK;
+}
+
+FieldRow base_cells(uint8_t y) {
+	if(y == 0) {
+		return pgm_read_byte(&baseFootprint[basePosition]);
+	} else if(y == 1) {
+		return 1 << basePosition;
+	}
+	return 0;
+}
+
+uint32_t game_tick_count(void) {
+	return gameTicks;
+}
+
 // Returns 1 if the game is over, 0 otherwise. Initially, the game is
 // never over.
 int8_t is_game_over(void) {
@@ -430,129 +549,180 @@ int8_t is_game_over(void) {
 
 // Check whether there is an asteroid at a given position.
 // Returns -1 if there is no asteroid, otherwise we return
-// the asteroid number (from 0 to numAsteroids-1).
+// the asteroid number (from 0 to asteroids.count-1).
 static int8_t asteroid_at(uint8_t x, uint8_t y) {
-	uint8_t i;
-	uint8_t positionToCheck = GAME_POSITION(x,y);
-	for(i=0; i < numAsteroids; i++) {
-		if(asteroids[i] == positionToCheck) {
-			// Asteroid i is at the given position
-			return i;
-		}
+	if(!asteroid_present(x,y)) {
+		// Nothing there - no need to search the pool
+		return -1;
 	}
-	// No match was found - no asteroid at the given position
-	return -1;
+	return pool_find(&asteroids, GAME_POSITION(x,y));
 }
 
 // Check whether there is a projectile at a given position.
 // Returns -1 if there is no projectile, otherwise we return
-// the projectile number (from 0 to numProjectiles-1).
+// the projectile number (from 0 to projectiles.count-1).
 static int8_t projectile_at(uint8_t x, uint8_t y) {
-	uint8_t i;
-	uint8_t positionToCheck = GAME_POSITION(x,y);
-	for(i=0; i < numProjectiles; i++) {
-		if(projectiles[i] == positionToCheck) {
-			// Projectile i is at the given position
-			return i;
-		}
+	if(!projectile_present(x,y)) {
+		// Nothing there - no need to search the pool
+		return -1;
 	}
-	// No match was found - no projectile at the given position 
-	return -1;
+	return pool_find(&projectiles, GAME_POSITION(x,y));
 }
 
-/* Remove asteroid with the given index number (from 0 to
-** numAsteroids - 1).
-*/
-static void remove_asteroid(int8_t asteroidNumber) {
-	if(asteroidNumber < 0 || asteroidNumber >= numAsteroids) {
-		// Invalid index - do nothing
-		return;
+// Check the asteroid occupancy bitboard for the given position.
+// Positions off the game field (e.g. x = -1 passed as 255) are
+// never occupied.
+static uint8_t asteroid_present(uint8_t x, uint8_t y) {
+	if(x >= FIELD_WIDTH || y >= FIELD_HEIGHT) {
+		return 0;
 	}
-	
-	// Remove the asteroid from the display
-	redraw_asteroid(asteroidNumber, COLOUR_BLACK);
-	
-	if(asteroidNumber < numAsteroids - 1) {
-		// Asteroid is not the last one in the list
-		// - move the last one in the list to this position
-		asteroids[asteroidNumber] = asteroids[numAsteroids - 1];
+	return asteroidRows[y] & (1 << x);
+}
+
+// Check the projectile occupancy bitboard for the given position.
+static uint8_t projectile_present(uint8_t x, uint8_t y) {
+	if(x >= FIELD_WIDTH || y >= FIELD_HEIGHT) {
+		return 0;
 	}
-	// Last position in asteroids array is no longer used
-	numAsteroids--;
+	return projectileRows[y] & (1 << x);
 }
 
-// Remove projectile with the given projectile number (from 0 to
-// numProjectiles - 1).
-static void remove_projectile(int8_t projectileNumber) {	
-	if(projectileNumber < 0 || projectileNumber >= numProjectiles) {
-		// Invalid index - do nothing 
-		return;
+// Add an asteroid to the asteroids pool and mark its position as
+// occupied.
+static int8_t add_asteroid(uint8_t x, uint8_t y) {
+	int8_t asteroidNumber = pool_add(&asteroids, GAME_POSITION(x,y));
+	if(asteroidNumber != POOL_NO_SLOT) {
+		SET_OCCUPIED(asteroidRows, asteroids.positions[asteroidNumber]);
+		fieldChanged = 1;
 	}
-	
-	// Remove the projectile from the display
-	redraw_projectile(projectileNumber, COLOUR_BLACK);
-	
-	// Close up the gap in the list of projectiles - move any
-	// projectiles after this in the list closer to the start of the list
-	for(uint8_t i = projectileNumber+1; i < numProjectiles; i++) {
-		projectiles[i-1] = projectiles[i];
+	return asteroidNumber;
+}
+
+// Each destroyed asteroid scores a point and starts an explosion
+// animation at the projectile's position.
+static void destroy_asteroids(uint8_t hits, uint8_t y) {
+	for(uint8_t x=0; hits; x++, hits >>= 1) {
+		if(hits & 1) {
+			sound_trigger(SOUND_HIT);
+			remove_projectile(projectile_at(x,y));
+			add_to_score(1);
+			animation_start(ANIMATION_EXPLOSION, x, y);
+		}
 	}
-	// Update projectile count - have one fewer projectiles now.
-	numProjectiles--;
 }
 
-// Redraw the whole display - base, asteroids and projectiles.
-// We assume all of the data structures have been appropriately poplulated
-static void redraw_whole_display(void) {
-	// clear the display
-	ledmatrix_clear();
-	
-	// Redraw each of the elements
-	redraw_base(COLOUR_BASE);
-	redraw_all_asteroids();	
-	redraw_all_projectiles();
+static uint8_t asteroids_in_row(uint8_t rowMask) {
+	return pgm_read_byte(&nibbleBits[rowMask & 0x0F]) + 
+			pgm_read_byte(&nibbleBits[rowMask >> 4]);
 }
 
-void redraw_base(uint8_t colour){
-	// Add the bottom row of the base first (0) followed by the single bit
-	// in the next row (1)
-	for(int8_t x = basePosition - 1; x <= basePosition+1; x++) {
-		if (x >= 0 && x < FIELD_WIDTH) {
-			ledmatrix_update_pixel(LED_MATRIX_POSN_FROM_XY(x, 0), colour);
+static uint8_t select_column(uint8_t mask, uint8_t n) {
+	uint8_t x = 0;
+	uint8_t lowBits = pgm_read_byte(&nibbleBits[mask & 0x0F]);
+	
+	// Skip the low nibble if the bit is in the high nibble, then step
+	// through the (at most 4) bits of the nibble
+	if(n >= lowBits) {
+		n -= lowBits;
+		mask >>= 4;
+		x = 4;
+	}
+	while(1) {
+		if(mask & 1) {
+			if(n == 0) {
+				return x;
+			}
+			n--;
 		}
+		mask >>= 1;
+		x++;
 	}
-	ledmatrix_update_pixel(LED_MATRIX_POSN_FROM_XY(basePosition, 1), colour);
 }
 
-void redraw_all_asteroids(void) {
-	// For each asteroid, determine it's position and redraw it
-	for(uint8_t i=0; i < numAsteroids; i++) {
-		redraw_asteroid(i, COLOUR_ASTEROID);
+static uint8_t random_free_column(uint8_t rowMask) {
+	uint8_t freeColumns = FIELD_WIDTH - asteroids_in_row(rowMask);
+	if(freeColumns == 0) {
+		return NO_FREE_COLUMN;
 	}
+	return select_column(~rowMask, prng_range(freeColumns));
 }
 
-static void redraw_asteroid(uint8_t asteroidNumber, uint8_t colour) {
-	uint8_t asteroidPosn;
-	if(asteroidNumber < numAsteroids) {
-		asteroidPosn = asteroids[asteroidNumber];
-		ledmatrix_update_pixel(LED_MATRIX_POSN_FROM_GAME_POSN(asteroidPosn), colour);
+static GamePosition random_free_position(uint8_t firstRow) {
+	uint8_t y, freeInRow;
+	uint16_t n, freeCells = 0;
+	
+	// Count the free cells, choose one of them at random and then 
+	// find the row and column it is in
+	for(y = firstRow; y < FIELD_HEIGHT; y++) {
+		freeCells += FIELD_WIDTH - asteroids_in_row(asteroidRows[y]);
+	}
+	if(freeCells == 0) {
+		return INVALID_POSITION;
+	}
+	n = prng_range16(freeCells);
+	for(y = firstRow; ; y++) {
+		freeInRow = FIELD_WIDTH - asteroids_in_row(asteroidRows[y]);
+		if(n < freeInRow) {
+			return GAME_POSITION(select_column(~asteroidRows[y], n), y);
+		}
+		n -= freeInRow;
+	}
+}
+
+// Remove the asteroid with the given asteroid number (from 0 to
+// asteroids.count - 1). The pool moves the last asteroid into its
+// slot.
+static void remove_asteroid(int8_t asteroidNumber) {
+	if(asteroidNumber < 0 || asteroidNumber >= asteroids.count) {
+		// Invalid index - do nothing
+		return;
 	}
+	
+	CLEAR_OCCUPIED(asteroidRows, asteroids.positions[asteroidNumber]);
+	pool_remove(&asteroids, asteroidNumber);
+	fieldChanged = 1;
 }
 
-void redraw_all_projectiles(void){
-	// For each projectile, determine its position and redraw it
-	for(uint8_t i = 0; i < numProjectiles; i++) {
-		redraw_projectile(i, COLOUR_PROJECTILE);
+// Remove projectile with the given projectile number (from 0 to
+// projectiles.count - 1). The pool moves the last projectile into
+// its slot.
+static void remove_projectile(int8_t projectileNumber) {	
+	if(projectileNumber < 0 || projectileNumber >= projectiles.count) {
+		// Invalid index - do nothing 
+		return;
 	}
+	
+	CLEAR_OCCUPIED(projectileRows, projectiles.positions[projectileNumber]);
+	pool_remove(&projectiles, projectileNumber);
+	fieldChanged = 1;
 }
 
-static void redraw_projectile(uint8_t projectileNumber, uint8_t colour) {
-	uint8_t projectilePosn;
+// Draw every cell of the field in the colour the game shows there
+// (see game_cell_colour()) - asteroids over projectiles over the base
+void game_compose(void) {
+	FieldRow asteroidRow, projectileRow, baseRow, bit;
+	PixelColour colour;
+	uint8_t x, y;
 	
-	// Check projectileNumber is valid - ignore otherwise
-	if(projectileNumber < numProjectiles) {
-		projectilePosn = projectiles[projectileNumber];
-		ledmatrix_update_pixel(LED_MATRIX_POSN_FROM_GAME_POSN(projectilePosn), colour);
+	if(!fieldChanged) {
+		return;
 	}
+	for(y=0; y < FIELD_HEIGHT; y++) {
+		asteroidRow = asteroidRows[y];
+		projectileRow = projectileRows[y];
+		baseRow = base_cells(y);
+		for(x=0, bit=1; x < FIELD_WIDTH; x++, bit <<= 1) {
+			if(asteroidRow & bit) {
+				colour = COLOUR_ASTEROID;
+			} else if(projectileRow & bit) {
+				colour = COLOUR_PROJECTILE;
+			} else if(baseRow & bit) {
+				colour = COLOUR_BASE;
+			} else {
+				colour = COLOUR_BLACK;
+			}
+			DRAW_POSITION(GAME_POSITION(x, y), colour);
+		}
+	}
+	fieldChanged = 0;
 }
-
@@ -10,13 +10,64 @@
 #define GAME_H_
 
 #include <inttypes.h>
+#include <avr/pgmspace.h>
+#include "pixel_colour.h"
+#include "ledmatrix.h"
 
-// The game field is 16 rows in size by 8 columns, i.e. x (column number)
-// ranges from 0 to 7 (left to right) and y (row number) ranges from
-// 0 to 15 (bottom to top).
+// The game field is FIELD_HEIGHT rows in size by 8 columns, i.e. x 
+// (column number) ranges from 0 to 7 (left to right) and y (row number)
+// ranges from 0 to FIELD_HEIGHT - 1 (bottom to top). By default the
+// field is 16 rows - one LED matrix panel. The field is always one 
+// panel wide (8 columns) but may be made taller (up to 64 rows) by
+// chaining more panels (see MATRIX_NUM_PANELS in ledmatrix.h), e.g. 
+// building with -DFIELD_HEIGHT=32 -DMATRIX_NUM_PANELS=2 
+// -DSPI_NUM_DEVICES=2.
+#ifndef FIELD_HEIGHT
 #define FIELD_HEIGHT 16
+#endif
 #define FIELD_WIDTH 8
 
+// Each row of the field fits in a FieldRow with bit x for column x
+// (see the occupancy bitboards in game.c)
+typedef uint8_t FieldRow;
+
+// Game positions (x,y) are represented in a single unsigned integer 
+// where the low FIELD_Y_BITS bits are the y value and the bits above
+// them are the x value - e.g. for the standard 16 row field the most
+// significant 4 bits of a byte are the x value and the least 
+// significant 4 bits are the y value. The following macros allow the
+// extraction of x and y values from a combined position value and the 
+// construction of a combined position value from separate x, y values.
+// Values are assumed to be in valid ranges. Invalid positions are any
+// where the x value is greater than 7. We use all 1's to represent 
+// this, so the position type is made big enough to leave room for it.
+#if FIELD_HEIGHT <= 16
+#define FIELD_Y_BITS 4
+#elif FIELD_HEIGHT <= 32
+#define FIELD_Y_BITS 5
+#elif FIELD_HEIGHT <= 64
+#define FIELD_Y_BITS 6
+#else
+#error "FIELD_HEIGHT can be at most 64"
+#endif
+#define FIELD_Y_MASK			((1 << FIELD_Y_BITS) - 1)
+#define FIELD_POSITIONS			(FIELD_WIDTH << FIELD_Y_BITS)
+#if FIELD_Y_BITS < 5
+typedef uint8_t GamePosition;
+#else
+typedef uint16_t GamePosition;
+#endif
+#define GAME_POSITION(x,y)		( ((x) << FIELD_Y_BITS)|((y) & FIELD_Y_MASK) )
+#define GET_X_POSITION(posn)	((posn) >> FIELD_Y_BITS)
+#define GET_Y_POSITION(posn)	((posn) & FIELD_Y_MASK)
+#define INVALID_POSITION		((GamePosition)~0)
+
+// LED matrix pixel address (see ledmatrix.h) of each game position,
+// indexed by the combined position value
+extern const MatrixAddress gamePositionAddress[FIELD_POSITIONS] PROGMEM;
+#define GAME_POSITION_ADDRESS(posn)	\
+		pgm_read_matrix_address(&gamePositionAddress[posn])
+
 // Limits on the number of asteroids and projectiles we can have on the 
 // game field at any one time. (These numbers should fit within the 
 // range of an int8_t type - i.e. max 127, though in reality
@@ -29,7 +80,9 @@
 #define MOVE_LEFT 0
 #define MOVE_RIGHT 1
 
-// Initialise the game and output the initial display
+// Initialise the game. The field is drawn by the next game_compose().
+// (The asteroid positions are random - seed the generator in prng.h 
+// first.)
 void initialise_game(void); 
 
 // Attempt to move the base station to the left or the right. Returns
@@ -47,6 +100,34 @@ int8_t fire_projectile(void);
 // go off the top or that hit an asteroid are removed.
 void advance_projectiles(void);
 
+// Move asteroids down by one position. Asteroids which hit a projectile
+// or the base station, or go off the bottom, are replaced at the top.
+void advance_asteroids(void);
+
+// Returns the time (in milliseconds) between asteroid moves. This gets
+// shorter as the score increases.
+uint16_t asteroid_period(void);
+
+// Returns the colour the game shows at the given position
+PixelColour game_cell_colour(uint8_t x, uint8_t y);
+
+// Returns the cells the base station covers in row y (bit x set for 
+// column x) - its footprint in row 0 and its centre in row 1
+FieldRow base_cells(uint8_t y);
+
+// Draw the game field into the LED matrix frame (see ledmatrix.h) if 
+// it has changed since the last call. The game functions above only 
+// change the game state - this should be called once per display 
+// update, before animation_compose() and ledmatrix_flush().
+void game_compose(void);
+
+// Returns the number of game ticks - calls to advance_asteroids() and
+// advance_projectiles() - since the game was initialised. Everything
+// that happens in the game apart from the player's inputs happens in
+// these ticks, so an input applied at the same tick count (and in the
+// same order) has the same effect.
+uint32_t game_tick_count(void);
+
 // Returns 1 if the game is over, 0 otherwise
 int8_t is_game_over(void);
 
@@ -0,0 +1,209 @@
+/*
+ * highscores.c
+ *
+ * Author: Alex Patapan
+ *
+ * The EEPROM holds a ring of HIGH_SCORE_SLOTS records, each a whole
+ * copy of the table with a sequence number and checksum. Each save 
+ * goes to the slot after the last one written (so the writes are 
+ * spread over the slots rather than wearing out one) with the next 
+ * sequence number. At startup the valid record with the latest 
+ * sequence number is used - a record only partly written when the 
+ * power went off fails its checksum (which is written last) so we 
+ * fall back to the one before.
+ *
+ * An EEPROM byte write takes about 3.4ms. Rather than waiting, the 
+ * record to be saved is copied to record_buffer and the EEPROM ready 
+ * interrupt handler writes it a byte at a time, skipping bytes which 
+ * already hold the right value. If the table changes again before 
+ * that's finished, the new table is saved straight after.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+
+#include "highscores.h"
+#include "terminalio.h"
+#include "memory.h"
+
+// EEPROM layout - HIGH_SCORE_SLOTS records from HIGH_SCORE_EEPROM_START
+#define HIGH_SCORE_EEPROM_START 0
+#define HIGH_SCORE_SLOTS 16
+
+typedef struct {
+	uint8_t seq;
+	uint32_t scores[HIGH_SCORE_COUNT];
+	uint8_t checksum;	// ~(sum of the other bytes)
+} HighScoreRecord;
+
+#define RECORD_SIZE sizeof(HighScoreRecord)
+#define SLOT_ADDRESS(slot) (HIGH_SCORE_EEPROM_START + (slot) * RECORD_SIZE)
+
+// The table (best first) and the sequence number and slot of the 
+// record last saved. These are only changed with interrupts disabled
+// since the interrupt handler may copy them.
+static uint32_t scores[HIGH_SCORE_COUNT];
+static uint8_t last_seq;
+static uint8_t last_slot;
+
+// Record being written, the next byte to write and its address. 
+// writing is 1 while the interrupt handler is writing and save_pending
+// is 1 if the table has changed since record_buffer was filled.
+static HighScoreRecord record_buffer;
+static volatile uint8_t write_index;
+static uint16_t write_address;
+static volatile uint8_t writing;
+static volatile uint8_t save_pending;
+
+// Static data used by this module (see memory.h)
+MEMORY_USAGE(highscores, sizeof(scores) + sizeof(last_seq) + 
+		sizeof(last_slot) + sizeof(record_buffer) + sizeof(write_index) +
+		sizeof(write_address) + sizeof(writing) + sizeof(save_pending), 0);
+
+static uint8_t record_checksum(const HighScoreRecord* record);
+static void start_save(void);
+
+void highscores_init(void) {
+	HighScoreRecord record;
+	uint8_t found = 0;
+	
+	for(uint8_t i = 0; i < HIGH_SCORE_COUNT; i++) {
+		scores[i] = 0;
+	}
+	last_seq = 0;
+	last_slot = HIGH_SCORE_SLOTS - 1;
+	writing = 0;
+	save_pending = 0;
+	
+	// Writes are atomic erase and write operations
+	EECR &= ~((1<<EEPM1)|(1<<EEPM0));
+	
+	// Find the latest valid record. Sequence numbers wrap around so
+	// "later" means less than half the range ahead.
+	for(uint8_t slot = 0; slot < HIGH_SCORE_SLOTS; slot++) {
+		eeprom_read_block(&record, (const void*)SLOT_ADDRESS(slot), RECORD_SIZE);
+		if(record.checksum != record_checksum(&record)) {
+			continue;
+		}
+		if(!found || (int8_t)(record.seq - last_seq) > 0) {
+			found = 1;
+			last_seq = record.seq;
+			last_slot = slot;
+			for(uint8_t i = 0; i < HIGH_SCORE_COUNT; i++) {
+				scores[i] = record.scores[i];
+			}
+		}
+	}
+}
+
+uint8_t highscores_add(uint32_t score) {
+	uint8_t interrupts_enabled = bit_is_set(SREG, SREG_I);
+	uint8_t rank = 0;
+	
+	while(rank < HIGH_SCORE_COUNT && scores[rank] >= score) {
+		rank++;
+	}
+	if(rank == HIGH_SCORE_COUNT) {
+		return 0;
+	}
+	
+	cli();
+	for(uint8_t i = HIGH_SCORE_COUNT - 1; i > rank; i--) {
+		scores[i] = scores[i - 1];
+	}
+	scores[rank] = score;
+	if(writing) {
+		save_pending = 1;
+	} else {
+		start_save();
+	}
+	if(interrupts_enabled) {
+		sei();
+	}
+	return rank + 1;
+}
+
+uint32_t highscores_get(uint8_t rank) {
+	if(rank < 1 || rank > HIGH_SCORE_COUNT) {
+		return 0;
+	}
+	return scores[rank - 1];
+}
+
+void highscores_show(int x, int y, uint8_t highlight) {
+	move_cursor(x, y);
+	printf_P(PSTR("High scores"));
+	for(uint8_t i = 0; i < HIGH_SCORE_COUNT; i++) {
+		move_cursor(x, y + 1 + i);
+		if(scores[i]) {
+			printf_P(PSTR("%c%u.%8lu"), (i + 1 == highlight) ? '*' : ' ', 
+					i + 1, scores[i]);
+		} else {
+			printf_P(PSTR(" %u.%8S"), i + 1, PSTR("-"));
+		}
+	}
+}
+
+static uint8_t record_checksum(const HighScoreRecord* record) {
+	const uint8_t* bytes = (const uint8_t*)record;
+	uint8_t sum = 0;
+	
+	for(uint8_t i = 0; i < RECORD_SIZE - 1; i++) {
+		sum += bytes[i];
+	}
+	return ~sum;
+}
+
+// Copy the table into record_buffer and start writing it to the next
+// slot. Must be called with interrupts disabled.
+static void start_save(void) {
+	last_seq++;
+	last_slot = (last_slot + 1) % HIGH_SCORE_SLOTS;
+	record_buffer.seq = last_seq;
+	for(uint8_t i = 0; i < HIGH_SCORE_COUNT; i++) {
+		record_buffer.scores[i] = scores[i];
+	}
+	record_buffer.checksum = record_checksum(&record_buffer);
+	write_address = SLOT_ADDRESS(last_slot);
+	write_index = 0;
+	writing = 1;
+	save_pending = 0;
+	
+	// The interrupt fires as soon as the EEPROM is ready
+	EECR |= (1<<EERIE);
+}
+
+// EEPROM ready - write the next byte of record_buffer which differs
+// from what the EEPROM already holds
+ISR(EE_READY_vect) {
+	const uint8_t* bytes = (const uint8_t*)&record_buffer;
+	
+	while(write_index < RECORD_SIZE) {
+		EEAR = write_address + write_index;
+		EECR |= (1<<EERE);
+		if(EEDR != bytes[write_index]) {
+			break;
+		}
+		write_index++;
+	}
+	if(write_index == RECORD_SIZE) {
+		// Finished - save again if the table has changed meanwhile
+		if(save_pending) {
+			start_save();
+		} else {
+			writing = 0;
+			EECR &= ~(1<<EERIE);
+		}
+		return;
+	}
+	
+	// EEAR is already set. EEPE must be set within 4 cycles of EEMPE.
+	EEDR = bytes[write_index++];
+	EECR |= (1<<EEMPE);
+	EECR |= (1<<EEPE);
+}
@@ -0,0 +1,40 @@
+/*
+ * highscores.h
+ *
+ * Author: Alex Patapan
+ *
+ * Table of the best HIGH_SCORE_COUNT scores, kept in EEPROM so that it
+ * survives a reset. The table is read from EEPROM once (by 
+ * highscores_init()) into a RAM copy which is used from then on.
+ * New entries are written back in the background by the EEPROM ready
+ * interrupt handler, so adding a score never waits for the EEPROM.
+ */
+
+#ifndef HIGHSCORES_H_
+#define HIGHSCORES_H_
+
+#include <stdint.h>
+
+#define HIGH_SCORE_COUNT 5
+
+// Number of terminal rows output by highscores_show()
+#define HIGH_SCORE_ROWS (HIGH_SCORE_COUNT + 1)
+
+// Load the table from EEPROM. Must be called once at startup, before
+// interrupts are enabled.
+void highscores_init(void);
+
+// Add a score to the table (if it is good enough) and start saving 
+// the table. Returns the rank of the score (1 is the best) or 0 if it
+// didn't make the table.
+uint8_t highscores_add(uint32_t score);
+
+// Return the score with the given rank (1 to HIGH_SCORE_COUNT) - 0 if
+// there isn't one yet
+uint32_t highscores_get(uint8_t rank);
+
+// Output the table to the terminal with its top left corner at (x, y).
+// The entry with rank highlight (if any - 0 for none) is marked.
+void highscores_show(int x, int y, uint8_t highlight);
+
+#endif /* HIGHSCORES_H_ */
@@ -0,0 +1,17 @@
+/*
+ * host/avr/interrupt.h
+ *
+ * Author: Alex Patapan
+ *
+ * There are no interrupts on the host - enabling and disabling them
+ * does nothing and interrupt handlers become ordinary functions.
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+#define sei()
+#define cli()
+#define ISR(vector) void vector(void)
+
+#endif /* HOST_AVR_INTERRUPT_H_ */
@@ -0,0 +1,27 @@
+/*
+ * host/avr/io.h
+ *
+ * Author: Alex Patapan
+ *
+ * Stand-in for the AVR register definitions when building the game
+ * modules on a PC (see host/bench.c). Registers are plain variables 
+ * (defined in host_io.c) so code which touches them still compiles
+ * and runs - it just has no effect.
+ */
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include <stdint.h>
+
+extern volatile uint8_t PORTA, PORTB, PORTC, PORTD;
+extern volatile uint8_t DDRA, DDRB, DDRC, DDRD;
+extern volatile uint8_t PINA, PINB, PINC, PIND;
+extern volatile uint8_t SREG;
+
+#define SREG_I 7
+
+#define _BV(bit) (1 << (bit))
+#define bit_is_set(sfr, bit) ((sfr) & _BV(bit))
+
+#endif /* HOST_AVR_IO_H_ */
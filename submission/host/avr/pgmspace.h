@@ -0,0 +1,35 @@
+/*
+ * host/avr/pgmspace.h
+ *
+ * Author: Alex Patapan
+ *
+ * On the host program memory is ordinary memory, so the PROGMEM
+ * attribute disappears and the pgm_read functions are plain reads.
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define PGM_P const char*
+
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#define pgm_read_word(address) (*(address))
+#define pgm_read_dword(address) (*(address))
+
+#define fputs_P fputs
+#define strlen_P strlen
+#define memcpy_P memcpy
+
+/* printf_P() format strings may use %S for a string in program memory
+ * (see host_serial.c)
+ */
+#define printf_P host_printf_P
+int host_printf_P(const char* format, ...);
+
+#endif /* HOST_AVR_PGMSPACE_H_ */
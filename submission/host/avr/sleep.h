@@ -0,0 +1,20 @@
+/*
+ * host/avr/sleep.h
+ *
+ * Author: Alex Patapan
+ *
+ * Sleeping until the next interrupt is simulated by moving the clock on
+ * to the next timer0 tick (see host_timer0.c).
+ */
+
+#ifndef HOST_AVR_SLEEP_H_
+#define HOST_AVR_SLEEP_H_
+
+#define SLEEP_MODE_IDLE 0
+
+void host_sleep(void);
+
+#define set_sleep_mode(mode)
+#define sleep_mode() host_sleep()
+
+#endif /* HOST_AVR_SLEEP_H_ */
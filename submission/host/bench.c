@@ -0,0 +1,161 @@
+/*
+ * host/bench.c
+ *
+ * Author: Alex Patapan
+ *
+ * Runs the game logic on a PC so that changes to game.c, ledmatrix.c
+ * etc. can be timed and checked without the board. A simple "bot" 
+ * moves the base and fires at random. When the bot loses, a new game
+ * is started. At the end we report the host time per simulated 
+ * millisecond and the number of bytes sent to the LED matrix and 
+ * terminal per simulated millisecond (these are what limit us on the
+ * AVR). Runs with the same arguments give the same game.
+ *
+ * Build and run from the submission directory with:
+ *	gcc -O2 -std=gnu99 -Ihost -I. -o bench host/host_*.c host/bench.c \
+ *		game.c entity_pool.c prng.c animation.c score.c scheduler.c \
+ *		intmath.c terminal_status.c terminalio.c ledmatrix.c profiler.c \
+ *		telemetry.c
+ *	./bench [milliseconds [seed]]
+ * (The default is 1000000 milliseconds of play with seed 0.)
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "game.h"
+#include "score.h"
+#include "ledmatrix.h"
+#include "scheduler.h"
+#include "terminalio.h"
+#include "terminal_status.h"
+#include "serialio.h"
+#include "timer0.h"
+#include "profiler.h"
+#include "sound.h"
+#include "prng.h"
+#include "animation.h"
+#include "host.h"
+
+// Sound needs the hardware. The game logic only needs this to exist.
+void sound_trigger(SoundId sound) {
+	(void)sound;
+}
+
+// Defined in game.c
+void update_terminal(void);
+
+static TaskId asteroid_task;
+static unsigned int bot_seed;
+static uint32_t games_played;
+
+static void move_asteroids(void) {
+	if(!is_game_over()) {
+		advance_asteroids();
+		scheduler_set_period(asteroid_task, asteroid_period());
+	}
+}
+
+static void move_projectiles(void) {
+	if(!is_game_over()) {
+		advance_projectiles();
+	}
+}
+
+// The bot stands in for a (fairly frantic) player - every 20ms it 
+// may move the base and may fire.
+static void bot_input(void) {
+	int action = rand_r(&bot_seed) % 8;
+	
+	if(is_game_over()) {
+		return;
+	}
+	if(action == 0) {
+		move_base(-1);
+	} else if(action == 1) {
+		move_base(1);
+	} else if(action < 4) {
+		fire_projectile();
+	}
+}
+
+static void update_display(void) {
+	game_compose();
+	animation_compose();
+	ledmatrix_flush();
+	terminal_status_flush();
+}
+
+// As per new_game() in project.c
+static void start_game(void) {
+	ledmatrix_clear();
+	initialise_game();
+	clear_terminal();
+	terminal_status_init();
+	init_score();
+	update_terminal();
+	init_animations();
+	games_played++;
+}
+
+int main(int argc, char** argv) {
+	uint32_t run_time = 1000000;
+	uint32_t seed = 0;
+	uint32_t spi_bytes, terminal_bytes;
+	struct timespec start, end;
+	double elapsed_ns;
+	
+	if(argc > 1) {
+		run_time = strtoul(argv[1], 0, 0);
+	}
+	if(argc > 2) {
+		seed = strtoul(argv[2], 0, 0);
+	}
+	bot_seed = seed;
+	prng_seed(seed);
+	
+	// As per initialise_hardware() in project.c
+	ledmatrix_setup();
+	init_serial_stdio(19200, 0);
+	init_timer0();
+	profile_init();
+	
+	start_game();
+	scheduler_init();
+	asteroid_task = scheduler_add_task(move_asteroids, asteroid_period());
+	scheduler_add_task(move_projectiles, 500);
+	scheduler_add_task(bot_input, 20);
+	scheduler_add_task(animation_step, ANIMATION_STEP_PERIOD);
+	scheduler_add_task(update_display, 0);
+	
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while(get_current_time() < run_time) {
+		scheduler_run();
+		if(is_game_over()) {
+			start_game();
+		}
+	}
+	ledmatrix_flush();
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	
+	elapsed_ns = (end.tv_sec - start.tv_sec) * 1e9 + 
+			(end.tv_nsec - start.tv_nsec);
+	spi_bytes = host_spi_bytes();
+	terminal_bytes = host_terminal_bytes();
+	fprintf(stderr, "simulated time:      %lu ms (seed %lu)\n", 
+			(unsigned long)get_current_time(), (unsigned long)seed);
+	fprintf(stderr, "games played:        %lu\n", 
+			(unsigned long)games_played);
+	fprintf(stderr, "host time:           %.1f ns per ms\n", 
+			elapsed_ns / get_current_time());
+	fprintf(stderr, "SPI bytes:           %lu (%.3f per ms)\n", 
+			(unsigned long)spi_bytes, 
+			(double)spi_bytes / get_current_time());
+	fprintf(stderr, "terminal bytes:      %lu (%.3f per ms)\n", 
+			(unsigned long)terminal_bytes, 
+			(double)terminal_bytes / get_current_time());
+	return 0;
+}
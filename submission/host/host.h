@@ -0,0 +1,26 @@
+/*
+ * host/host.h
+ *
+ * Author: Alex Patapan
+ *
+ * Controls and counters provided by the host (PC) back ends which 
+ * replace spi.c, timer0.c and serialio.c in the host build.
+ */
+
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <stdint.h>
+
+/* Simulated clock (milliseconds). host_advance_time() moves it on by
+ * the given amount.
+ */
+void host_advance_time(uint32_t ms);
+
+/* Number of bytes sent via SPI to the LED matrix and written to the
+ * serial terminal since the program started.
+ */
+uint32_t host_spi_bytes(void);
+uint32_t host_terminal_bytes(void);
+
+#endif /* HOST_H_ */
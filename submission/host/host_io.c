@@ -0,0 +1,15 @@
+/*
+ * host/host_io.c
+ *
+ * Author: Alex Patapan
+ *
+ * Register variables for host/avr/io.h. PIND bit 3 (the sound switch) 
+ * is off so the game is silent.
+ */
+
+#include <avr/io.h>
+
+volatile uint8_t PORTA, PORTB, PORTC, PORTD;
+volatile uint8_t DDRA, DDRB, DDRC, DDRD;
+volatile uint8_t PINA, PINB, PINC, PIND;
+volatile uint8_t SREG = (1 << SREG_I);
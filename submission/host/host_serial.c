@@ -0,0 +1,110 @@
+/*
+ * host/host_serial.c
+ *
+ * Author: Alex Patapan
+ *
+ * Host replacement for serialio.c. Output to the "terminal" is 
+ * counted and discarded. There is never any input.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "serialio.h"
+#include "host.h"
+
+static uint32_t bytes_written;
+
+static ssize_t count_output(void* cookie, const char* buffer, size_t size) {
+	(void)cookie;
+	(void)buffer;
+	bytes_written += size;
+	return size;
+}
+
+void init_serial_stdio(long baudrate, int8_t echo) {
+	cookie_io_functions_t functions = { 0, count_output, 0, 0 };
+	(void)baudrate;
+	(void)echo;
+	stdout = fopencookie(0, "w", functions);
+}
+
+int8_t serial_input_available(void) {
+	return 0;
+}
+
+void clear_serial_input_buffer(void) {
+}
+
+uint8_t serial_read(char* buffer, uint8_t length) {
+	(void)buffer;
+	(void)length;
+	return 0;
+}
+
+uint8_t serial_write(const char* buffer, uint8_t length) {
+	(void)buffer;
+	bytes_written += length;
+	return length;
+}
+
+uint16_t serial_input_overruns(void) {
+	return 0;
+}
+
+uint16_t serial_output_overruns(void) {
+	return 0;
+}
+
+void serial_set_binary(int8_t binary) {
+	(void)binary;
+}
+
+int8_t serial_is_binary(void) {
+	return 0;
+}
+
+int8_t serial_write_frame(uint8_t type, const uint8_t* payload, uint8_t length) {
+	(void)type;
+	(void)payload;
+	bytes_written += length + 4;
+	return 1;
+}
+
+uint32_t host_terminal_bytes(void) {
+	fflush(stdout);
+	return bytes_written;
+}
+
+/* Our printf_P() - program memory strings (%S) are ordinary strings 
+ * on the host.
+ */
+int host_printf_P(const char* format, ...) {
+	char host_format[256];
+	va_list args;
+	int result;
+	size_t i;
+	
+	int8_t in_conversion = 0;
+	
+	for(i=0; format[i] && i < sizeof(host_format) - 1; i++) {
+		host_format[i] = format[i];
+		if(!in_conversion) {
+			in_conversion = (format[i] == '%');
+		} else if(format[i] == 'S') {
+			host_format[i] = 's';
+			in_conversion = 0;
+		} else if(!strchr("-0123456789l", format[i])) {
+			in_conversion = 0;
+		}
+	}
+	host_format[i] = 0;
+	
+	va_start(args, format);
+	result = vprintf(host_format, args);
+	va_end(args);
+	return result;
+}
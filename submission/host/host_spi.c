@@ -0,0 +1,55 @@
+/*
+ * host/host_spi.c
+ *
+ * Author: Alex Patapan
+ *
+ * Host replacement for spi.c - bytes are counted rather than sent.
+ */
+
+#include "spi.h"
+#include "host.h"
+
+static uint32_t bytes_sent;
+
+void spi_setup_master(uint8_t clockdivider) {
+	(void)clockdivider;
+}
+
+uint8_t spi_send_byte(uint8_t byte) {
+	(void)byte;
+	bytes_sent++;
+	return 0;
+}
+
+void spi_queue_byte(uint8_t byte) {
+	(void)byte;
+	bytes_sent++;
+}
+
+void spi_queue_bytes(const uint8_t* bytes, uint8_t length) {
+	(void)bytes;
+	bytes_sent += length;
+}
+
+void spi_queue_select(uint8_t device) {
+	(void)device;
+}
+
+void spi_queue_clock(uint8_t clockdivider) {
+	(void)clockdivider;
+}
+
+void spi_set_pacing(uint8_t burst, uint8_t bytes_per_ms) {
+	(void)burst;
+	(void)bytes_per_ms;
+}
+
+void spi_pacing_tick(void) {
+}
+
+void spi_drain(void) {
+}
+
+uint32_t host_spi_bytes(void) {
+	return bytes_sent;
+}
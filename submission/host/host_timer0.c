@@ -0,0 +1,63 @@
+/*
+ * host/host_timer0.c
+ *
+ * Author: Alex Patapan
+ *
+ * Host replacement for timer0.c. Time only moves when the program 
+ * sleeps (waiting for the next "interrupt") or delays, so runs are 
+ * deterministic and as fast as the host can go.
+ */
+
+#include "timer0.h"
+#include "host.h"
+
+static uint32_t clockTicks;
+
+void init_timer0(void) {
+	clockTicks = 0;
+}
+
+uint32_t get_current_time(void) {
+	return clockTicks;
+}
+
+uint32_t get_fine_time(void) {
+	return clockTicks * TIMER0_COUNTS_PER_MS;
+}
+
+/* Game time is the clock tick count less the total time it has been
+ * paused for. While paused it stays at the value it had when paused.
+ */
+static uint32_t paused_total;
+static uint32_t pause_start;
+static uint8_t game_time_paused;
+
+uint32_t get_game_time(void) {
+	if(game_time_paused) {
+		return pause_start - paused_total;
+	}
+	return get_current_time() - paused_total;
+}
+
+void pause_game_time(void) {
+	if(!game_time_paused) {
+		pause_start = get_current_time();
+		game_time_paused = 1;
+	}
+}
+
+void resume_game_time(void) {
+	if(game_time_paused) {
+		paused_total += get_current_time() - pause_start;
+		game_time_paused = 0;
+	}
+}
+
+void host_advance_time(uint32_t ms) {
+	clockTicks += ms;
+}
+
+/* Sleeping lasts until the next timer0 interrupt. */
+void host_sleep(void) {
+	clockTicks++;
+}
@@ -0,0 +1,16 @@
+/*
+ * host/util/delay.h
+ *
+ * Author: Alex Patapan
+ */
+
+#ifndef HOST_UTIL_DELAY_H_
+#define HOST_UTIL_DELAY_H_
+
+#include <stdint.h>
+
+void host_advance_time(uint32_t ms);
+
+#define _delay_ms(ms) host_advance_time(ms)
+
+#endif /* HOST_UTIL_DELAY_H_ */
@@ -0,0 +1,127 @@
+/*
+ * input_decoder.c
+ *
+ * Author: Alex Patapan
+ *
+ * Serial input is decoded with a state machine. The transitions out of 
+ * each state are listed in the transitions table - the first entry 
+ * which matches the input character gives the next state and the 
+ * action (if any). Each state's list ends with an ANY_CHAR entry which 
+ * matches everything else.
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include "input_decoder.h"
+#include "buttons.h"
+#include "serialio.h"
+#include "memory.h"
+
+// ASCII code for Escape character
+#define ESCAPE_CHAR 27
+
+// Matches any character (must be the last transition for a state)
+#define ANY_CHAR 0
+
+// Decoder states - normal input, after an escape character and after 
+// escape [ (the Control Sequence Introducer)
+#define STATE_NORMAL	0
+#define STATE_ESCAPE	1
+#define STATE_CSI		2
+
+// Added to a next state to say the character should be decoded again
+// in that state. (If escape isn't followed by [, the character is 
+// treated as normal input.)
+#define REDECODE		0x80
+
+typedef struct {
+	char character;
+	uint8_t next_state;
+	uint16_t action;
+} Transition;
+
+static const Transition transitions[] PROGMEM = {
+	// STATE_NORMAL
+	{ ESCAPE_CHAR,	STATE_ESCAPE,	0 },
+	{ 'L',			STATE_NORMAL,	ACTION_LEFT },
+	{ 'l',			STATE_NORMAL,	ACTION_LEFT },
+	{ 'R',			STATE_NORMAL,	ACTION_RIGHT },
+	{ 'r',			STATE_NORMAL,	ACTION_RIGHT },
+	{ ' ',			STATE_NORMAL,	ACTION_FIRE },
+	{ 'P',			STATE_NORMAL,	ACTION_PAUSE },
+	{ 'p',			STATE_NORMAL,	ACTION_PAUSE },
+	{ '?',			STATE_NORMAL,	ACTION_REPORT },
+	{ 'X',			STATE_NORMAL,	ACTION_EXPORT },
+	{ 'x',			STATE_NORMAL,	ACTION_EXPORT },
+	{ 'Z',			STATE_NORMAL,	ACTION_REPLAY },
+	{ 'z',			STATE_NORMAL,	ACTION_REPLAY },
+	{ 'T',			STATE_NORMAL,	ACTION_TELEMETRY },
+	{ 't',			STATE_NORMAL,	ACTION_TELEMETRY },
+	{ ANY_CHAR,		STATE_NORMAL,	0 },
+	// STATE_ESCAPE
+	{ '[',			STATE_CSI,		0 },
+	{ ANY_CHAR,		STATE_NORMAL | REDECODE,	0 },
+	// STATE_CSI - cursor keys. (Down is ignored at present.)
+	{ 'D',			STATE_NORMAL,	ACTION_LEFT },
+	{ 'C',			STATE_NORMAL,	ACTION_RIGHT },
+	{ 'A',			STATE_NORMAL,	ACTION_FIRE },
+	{ ANY_CHAR,		STATE_NORMAL,	0 }
+};
+
+// Index of the first transition for each state
+static const uint8_t state_transitions[] PROGMEM = { 0, 16, 18 };
+
+// Actions for buttons 0 to 3. (Button 1 is ignored at present.) Every
+// button also gives ACTION_BUTTON.
+static const uint8_t button_actions[4] PROGMEM = {
+	ACTION_RIGHT | ACTION_BUTTON, ACTION_BUTTON, 
+	ACTION_FIRE | ACTION_BUTTON, ACTION_LEFT | ACTION_BUTTON };
+
+static uint8_t state;
+
+// Static data used by this module (see memory.h)
+MEMORY_USAGE(input_decoder, sizeof(state), sizeof(transitions) + 
+		sizeof(state_transitions) + sizeof(button_actions));
+
+static uint16_t decode_char(char c);
+
+void input_decoder_reset(void) {
+	state = STATE_NORMAL;
+}
+
+uint16_t input_decoder_next(void) {
+	uint16_t actions;
+	int8_t button;
+	char c;
+	
+	if((button = button_pushed()) != NO_BUTTON_PUSHED) {
+		return pgm_read_byte(&button_actions[button]);
+	}
+	while(serial_read(&c, 1) > 0) {
+		if((actions = decode_char(c))) {
+			return actions;
+		}
+	}
+	return 0;
+}
+
+// Move the state machine on by one character and return the resulting
+// action (if any)
+static uint16_t decode_char(char c) {
+	const Transition* transition;
+	char character;
+	uint8_t next_state;
+	
+	do {
+		transition = &transitions[pgm_read_byte(&state_transitions[state])];
+		while((character = pgm_read_byte(&transition->character)) != ANY_CHAR && 
+				character != c) {
+			transition++;
+		}
+		next_state = pgm_read_byte(&transition->next_state);
+		state = next_state & ~REDECODE;
+	} while(next_state & REDECODE);
+	
+	return pgm_read_word(&transition->action);
+}
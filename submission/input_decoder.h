@@ -0,0 +1,37 @@
+/*
+ * input_decoder.h
+ *
+ * Author: Alex Patapan
+ *
+ * Turns button pushes and serial input (including cursor key escape 
+ * sequences) into game actions.
+ */
+
+#ifndef INPUT_DECODER_H_
+#define INPUT_DECODER_H_
+
+#include <stdint.h>
+
+// Game actions
+#define ACTION_LEFT		(1<<0)
+#define ACTION_RIGHT	(1<<1)
+#define ACTION_FIRE		(1<<2)
+#define ACTION_PAUSE	(1<<3)
+#define ACTION_REPORT	(1<<4)
+#define ACTION_EXPORT	(1<<5)	// output the replay log
+#define ACTION_REPLAY	(1<<6)	// replay the last game
+#define ACTION_BUTTON	(1<<7)	// any push button was pushed
+#define ACTION_TELEMETRY (1<<8)	// switch between text and binary output
+
+// Forget any partly received escape sequence
+void input_decoder_reset(void);
+
+// Decode the next button push or key (or cursor key escape sequence)
+// which is waiting and return the actions it asks for (ACTION_LEFT 
+// etc. - a button gives ACTION_BUTTON too). Button pushes come before
+// serial input; otherwise inputs are returned in the order they 
+// arrived. Input which doesn't ask for an action is skipped. Returns 0
+// once there is no more input, so call this until it returns 0.
+uint16_t input_decoder_next(void);
+
+#endif /* INPUT_DECODER_H_ */
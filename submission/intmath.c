@@ -0,0 +1,55 @@
+/*
+ * intmath.c
+ *
+ * Author: Alex Patapan
+ */
+
+#include <avr/pgmspace.h>
+
+#include "intmath.h"
+
+/* Powers of ten used for formatting - we work out each digit by
+ * repeated subtraction which is much cheaper on the AVR than a 
+ * 32 bit division.
+ */
+static const uint32_t powers_of_ten[U32_MAX_DIGITS] PROGMEM = {
+		1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+		10000UL, 1000UL, 100UL, 10UL, 1UL };
+
+uint8_t format_u32(uint32_t value, char* buffer) {
+	uint8_t length = 0;
+	uint32_t power;
+	char digit;
+	
+	for(uint8_t i=0; i < U32_MAX_DIGITS; i++) {
+		power = pgm_read_dword(&powers_of_ten[i]);
+		digit = '0';
+		while(value >= power) {
+			value -= power;
+			digit++;
+		}
+		// Skip leading zeroes (but always output the last digit)
+		if(length > 0 || digit != '0' || i == U32_MAX_DIGITS - 1) {
+			buffer[length++] = digit;
+		}
+	}
+	buffer[length] = 0;
+	return length;
+}
+
+uint8_t split_tens_ones(uint8_t value, uint8_t* ones) {
+	uint8_t tens = 0;
+	if(value > 99) {
+		value = 99;
+	}
+	while(value >= 10) {
+		value -= 10;
+		tens++;
+	}
+	*ones = value;
+	return tens;
+}
+
+uint32_t q8_multiply(uint32_t value, uint16_t factor) {
+	return (value * factor) >> 8;
+}
@@ -0,0 +1,43 @@
+/*
+ * intmath.h
+ *
+ * Author: Alex Patapan
+ *
+ * Integer-only number formatting and fixed point helpers. These
+ * avoid pulling the floating point library and vfprintf() into the
+ * display and timing paths. None of these functions allocate memory -
+ * output is written to a buffer supplied by the caller.
+ */
+
+#ifndef INTMATH_H_
+#define INTMATH_H_
+
+#include <stdint.h>
+
+/* Longest string format_u32() can produce (excluding the null terminator) */
+#define U32_MAX_DIGITS 10
+
+/* Convert a fixed point constant to 8.8 format, rounding to the nearest 
+ * step, e.g. Q8(1.8) is 461. Only use this with constants so that the
+ * floating point arithmetic is done by the compiler.
+ */
+#define Q8(value) ((uint16_t)((value) * 256.0 + 0.5))
+
+/* Write the decimal representation of value (no leading zeroes) to 
+ * buffer, followed by a null terminator. The buffer must have room 
+ * for U32_MAX_DIGITS + 1 characters. Returns the number of digits
+ * written. No division is used.
+ */
+uint8_t format_u32(uint32_t value, char* buffer);
+
+/* Split a value from 0 to 99 into its tens and ones digits. Values 
+ * above 99 are treated as 99. The tens digit is returned.
+ */
+uint8_t split_tens_ones(uint8_t value, uint8_t* ones);
+
+/* Multiply a value by an 8.8 fixed point factor (see Q8() above), 
+ * returning the integer part of the result.
+ */
+uint32_t q8_multiply(uint32_t value, uint16_t factor);
+
+#endif /* INTMATH_H_ */
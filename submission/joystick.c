@@ -0,0 +1,119 @@
+/*
+ * joystick.c
+ *
+ * Author: Alex Patapan
+ *
+ * The ADC is auto-triggered by the timer0 compare match A flag which is
+ * set every millisecond (and cleared by the timer0 interrupt handler). 
+ * The conversion complete interrupt handler stores the sample and 
+ * switches the multiplexer to the other axis - this takes effect for
+ * the next conversion, so each axis is sampled every 2ms.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "joystick.h"
+#include "memory.h"
+
+// Thresholds (in ADC units, 0 - 1023) at which an axis becomes pushed
+// and stops being pushed. The gap between the two stops the state
+// flickering when the joystick is held near a threshold.
+#define HIGH_PUSHED		700
+#define HIGH_RELEASED	650
+#define LOW_PUSHED		300
+#define LOW_RELEASED	350
+
+// Smoothed value of each axis, multiplied by 4 (2 to the power of 
+// FILTER_SHIFT). Each new sample moves this a quarter of the way 
+// towards the sample.
+#define FILTER_SHIFT 2
+static uint16_t filtered[2];
+
+// Directions currently pushed and pushes not yet collected by 
+// joystick_events(). These are updated by the interrupt handler.
+static volatile uint8_t state;
+static volatile uint8_t events;
+
+// Axis being converted (0 = X, 1 = Y)
+static uint8_t axis;
+
+// Static data used by this module (see memory.h)
+MEMORY_USAGE(joystick, sizeof(filtered) + sizeof(state) + sizeof(events) +
+		sizeof(axis), 0);
+
+void init_joystick(void) {
+	// Start each axis in the middle (not pushed)
+	filtered[0] = filtered[1] = 512 << FILTER_SHIFT;
+	state = 0;
+	events = 0;
+	axis = 0;
+	
+	// Turn off the digital input buffers on the joystick pins - they
+	// only waste power on analog inputs
+	DIDR0 |= (1<<ADC0D)|(1<<ADC1D);
+	
+	// AVCC reference, right adjust, start with ADC0 (X axis)
+	ADMUX = (1<<REFS0);
+	
+	// Trigger on timer0 compare match A
+	ADCSRB = (1<<ADTS1)|(1<<ADTS0);
+	
+	// Turn on the ADC with a clock of 8MHz/64 (125kHz - a conversion 
+	// takes about 0.1ms), auto triggering and the conversion complete 
+	// interrupt. Clear any stale conversion complete flag.
+	ADCSRA = (1<<ADEN)|(1<<ADATE)|(1<<ADIE)|(1<<ADIF)|
+			(1<<ADPS2)|(1<<ADPS1);
+}
+
+uint8_t joystick_state(void) {
+	return state;
+}
+
+uint8_t joystick_events(void) {
+	uint8_t result;
+	
+	// Save whether interrupts were enabled and turn them off so that
+	// a push can't arrive between reading and clearing the events
+	int8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	result = events;
+	events = 0;
+	if(interrupts_were_enabled) {
+		sei();
+	}
+	return result;
+}
+
+// Conversion complete interrupt handler
+ISR(ADC_vect) {
+	uint8_t high_direction, low_direction, new_state;
+	uint16_t value;
+	
+	// Update the smoothed value for this axis
+	filtered[axis] += ADC - (filtered[axis] >> FILTER_SHIFT);
+	value = filtered[axis] >> FILTER_SHIFT;
+	
+	if(axis == 0) {
+		high_direction = JOYSTICK_LEFT;
+		low_direction = JOYSTICK_RIGHT;
+	} else {
+		high_direction = JOYSTICK_UP;
+		low_direction = JOYSTICK_DOWN;
+	}
+	
+	new_state = state & ~(high_direction | low_direction);
+	if(value >= HIGH_PUSHED || 
+			(value > HIGH_RELEASED && (state & high_direction))) {
+		new_state |= high_direction;
+	} else if(value <= LOW_PUSHED || 
+			(value < LOW_RELEASED && (state & low_direction))) {
+		new_state |= low_direction;
+	}
+	events |= new_state & ~state;
+	state = new_state;
+	
+	// Convert the other axis next time
+	axis ^= 1;
+	ADMUX = (ADMUX & ~(1<<MUX0)) | axis;
+}
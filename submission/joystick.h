@@ -0,0 +1,39 @@
+/*
+ * joystick.h
+ *
+ * Author: Alex Patapan
+ *
+ * The joystick X and Y axes (ADC0 and ADC1) are sampled by the ADC in 
+ * the background - a conversion is started every millisecond by timer0 
+ * and the two axes are read alternately. Each axis is smoothed and 
+ * compared against thresholds (with hysteresis) to give a deflection 
+ * state which can be read at any time without waiting for the ADC.
+ */
+
+#ifndef JOYSTICK_H_
+#define JOYSTICK_H_
+
+#include <stdint.h>
+
+// Joystick directions. (The X axis reads high when pushed to the left 
+// on our board.)
+#define JOYSTICK_LEFT	(1<<0)
+#define JOYSTICK_RIGHT	(1<<1)
+#define JOYSTICK_UP		(1<<2)
+#define JOYSTICK_DOWN	(1<<3)
+
+// Set up the ADC and start sampling. timer0 must also be initialised
+// (init_timer0()) as it triggers the conversions. Interrupts must be
+// enabled for sampling to take place.
+void init_joystick(void);
+
+// Return the directions (JOYSTICK_LEFT etc. ORed together) in which 
+// the joystick is currently pushed
+uint8_t joystick_state(void);
+
+// Return the directions in which the joystick has been pushed since 
+// this function was last called (i.e. the direction was not pushed 
+// and then was). These events are then cleared.
+uint8_t joystick_events(void);
+
+#endif /* JOYSTICK_H_ */
@@ -4,11 +4,25 @@
  * Author: Peter Sutton
  * 
  * See the LED matrix Reference for details of the SPI commands used.
+ *
+ * We keep a shadow copy of the display in RAM. The update functions
+ * below only modify the shadow copy (and mark the rows that have been
+ * touched as dirty). Nothing is sent to the LED matrix until 
+ * ledmatrix_flush() is called - this compares the shadow copy against 
+ * what we last sent and sends just the pixels that have really changed,
+ * using whichever commands need the fewest bytes.
+ *
+ * Commands are added to the SPI transmit queue and sent by the SPI 
+ * interrupt handler, so these functions generally return before the 
+ * LED matrix has been updated. Use ledmatrix_wait_until_sent() where we 
+ * must wait for that.
  */ 
 
 #include <avr/io.h>
 #include "ledmatrix.h"
 #include "spi.h"
+#include "timer0.h"
+#include "memory.h"
 
 #define CMD_UPDATE_ALL 0x00
 #define CMD_UPDATE_PIXEL 0x01
@@ -17,20 +31,100 @@
 #define CMD_SHIFT_DISPLAY 0x04
 #define CMD_CLEAR_SCREEN 0x0F
 
+// Number of SPI bytes required for each command
+#define CMD_UPDATE_ALL_BYTES	(1 + MATRIX_PANEL_COLUMNS * MATRIX_NUM_ROWS)
+#define CMD_UPDATE_PIXEL_BYTES	3
+#define CMD_UPDATE_ROW_BYTES	(2 + MATRIX_PANEL_COLUMNS)
+#define CMD_UPDATE_COL_BYTES	(2 + MATRIX_NUM_ROWS)
+
+#define ALL_ROWS_DIRTY			((1 << MATRIX_NUM_ROWS) - 1)
+
+#if MATRIX_NUM_PANELS > SPI_NUM_DEVICES
+#error "Each LED matrix panel needs its own SPI device - set SPI_NUM_DEVICES"
+#endif
+
+// flush_panel() keeps a bit per panel column in a uint16_t
+#if MATRIX_PANEL_COLUMNS > 16
+#error "MATRIX_PANEL_COLUMNS must be no more than 16"
+#endif
+
+// Panel which shows column x and the first column of panel p
+#define PANEL(x)				((x) / MATRIX_PANEL_COLUMNS)
+#define FIRST_COLUMN(p)			((p) * MATRIX_PANEL_COLUMNS)
+
+// frame - the display contents as they should be
+// shown - the display contents as last sent to the LED matrix
+// dirty_rows - bit y of dirty_rows[p] is set if row y of panel p of 
+// frame may differ from shown
+static MatrixData frame;
+static MatrixData shown;
+static uint8_t dirty_rows[MATRIX_NUM_PANELS];
+
+// Pacing used for the LED matrix (see ledmatrix_calibrate())
+static uint8_t pacing_burst = LEDMATRIX_BURST_BYTES;
+static uint8_t pacing_rate = LEDMATRIX_BYTES_PER_MS;
+
+/* Static data used by this module (see memory.h) */
+MEMORY_USAGE(ledmatrix, sizeof(frame) + sizeof(shown) + sizeof(dirty_rows) +
+		sizeof(pacing_burst) + sizeof(pacing_rate), 0);
+
+static void mark_rows_dirty(uint8_t rows);
+static void flush_panel(uint8_t panel);
+static void send_shift(uint8_t direction);
+static void send_pixel(uint8_t x, uint8_t y);
+static void send_row(uint8_t panel, uint8_t y);
+static void send_column(uint8_t x);
+static void send_all(uint8_t panel);
+static void send_clear(uint8_t panel);
+static uint8_t panel_is_blank(uint8_t panel);
+
 void ledmatrix_setup(void) {
-	// Setup SPI - we divide the clock by 128.
-	// (This speed guarantees the SPI buffer will never overflow on
-	// the LED matrix.)
-	spi_setup_master(128);
+	// Setup SPI at the command speed with pacing (see ledmatrix.h)
+	spi_setup_master(LEDMATRIX_COMMAND_DIVIDER);
+	spi_set_pacing(pacing_burst, pacing_rate);
+	
+	// Start from a known (blank) display so that our shadow copy
+	// matches the LED matrix
+	for(uint8_t p=0; p<MATRIX_NUM_PANELS; p++) {
+		spi_queue_select(p);
+		send_clear(p);
+	}
+}
+
+void ledmatrix_calibrate(void) {
+	uint16_t counts;
+	uint32_t rate;
+	
+	if(LEDMATRIX_BYTES_PER_MS) {
+		// Fixed rate
+		return;
+	}
+	// Time a frame sent flat out (the shadow copy is sent, so the 
+	// display doesn't change). The bucket holds at most a burst, so it
+	// has to hold at least a millisecond's worth to reach the rate.
+	counts = ledmatrix_frame_time(LEDMATRIX_DATA_DIVIDER, 0);
+	if(counts == 0) {
+		counts = 1;
+	}
+	rate = (uint32_t)MATRIX_NUM_PANELS * CMD_UPDATE_ALL_BYTES * 
+			TIMER0_COUNTS_PER_MS / counts;
+	pacing_rate = (rate > UINT8_MAX) ? UINT8_MAX : (rate ? rate : 1);
+	pacing_burst = (pacing_rate > LEDMATRIX_BURST_BYTES) ? 
+			pacing_rate : LEDMATRIX_BURST_BYTES;
+	spi_set_pacing(pacing_burst, pacing_rate);
+}
+
+uint8_t ledmatrix_bytes_per_ms(void) {
+	return pacing_rate;
 }
 
 void ledmatrix_update_all(MatrixData data) {
-	(void)spi_send_byte(CMD_UPDATE_ALL);
-	for(uint8_t y=0; y<MATRIX_NUM_ROWS; y++) {
-		for(uint8_t x=0; x<MATRIX_NUM_COLUMNS; x++) {
-			(void)spi_send_byte(data[x][y]);
+	for(uint8_t x=0; x<MATRIX_NUM_COLUMNS; x++) {
+		for(uint8_t y=0; y<MATRIX_NUM_ROWS; y++) {
+			frame[x][y] = data[x][y];
 		}
 	}
+	mark_rows_dirty(ALL_ROWS_DIRTY);
 }
 
 void ledmatrix_update_pixel(uint8_t x, uint8_t y, PixelColour pixel) {
@@ -38,9 +132,15 @@ void ledmatrix_update_pixel(uint8_t x, uint8_t y, PixelColour pixel) {
 		// Position isn't valid - we ignore the request.
 		return;
 	}
-	(void)spi_send_byte(CMD_UPDATE_PIXEL);
-	(void)spi_send_byte( ((y & 0x07)<<4) | (x & 0x0F));
-	(void)spi_send_byte(pixel);
+	frame[x][y] = pixel;
+	dirty_rows[PANEL(x)] |= (1 << y);
+}
+
+void ledmatrix_update_pixel_at(MatrixAddress address, PixelColour pixel) {
+	// frame[x][y] is element x * MATRIX_NUM_ROWS + y of the array
+	((PixelColour*)frame)[address] = pixel;
+	dirty_rows[PANEL(MATRIX_ADDRESS_X(address))] |= 
+			(1 << MATRIX_ADDRESS_Y(address));
 }
 
 void ledmatrix_update_row(uint8_t y, MatrixRow row) {
@@ -48,11 +148,10 @@ void ledmatrix_update_row(uint8_t y, MatrixRow row) {
 		// y value is too large - we ignore the request
 		return;
 	}
-	(void)spi_send_byte(CMD_UPDATE_ROW);
-	(void)spi_send_byte(y & 0x07);	// row number
 	for(uint8_t x = 0; x<MATRIX_NUM_COLUMNS; x++) {
-		(void)spi_send_byte(row[x]);
+		frame[x][y] = row[x];
 	}
+	mark_rows_dirty(1 << y);
 }
 
 void ledmatrix_update_column(uint8_t x, MatrixColumn col) {
@@ -60,35 +159,119 @@ void ledmatrix_update_column(uint8_t x, MatrixColumn col) {
 		// x value is too large - we ignore the request
 		return;
 	}
-	(void)spi_send_byte(CMD_UPDATE_COL);
-	(void)spi_send_byte(x & 0x0F); // column number
 	for(uint8_t y = 0; y<MATRIX_NUM_ROWS; y++) {
-		(void)spi_send_byte(col[y]);
+		frame[x][y] = col[y];
 	}
+	dirty_rows[PANEL(x)] = ALL_ROWS_DIRTY;
 }
 
+// The shift commands are sent straight away (after any pending
+// changes) since they are much cheaper than resending the display. 
+// Both shadow copies are shifted the same way as the LED matrix
+// contents, with the vacated column/row becoming blank. With more 
+// than one panel each panel shifts separately, so the columns which 
+// should move from one panel to the next are left dirty in frame and
+// are sent by the next flush.
 void ledmatrix_shift_display_left(void) {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x02);
+	ledmatrix_flush();
+	send_shift(0x02);
+	for(uint8_t x=0; x<MATRIX_NUM_COLUMNS-1; x++) {
+		copy_matrix_column(frame[x+1], frame[x]);
+		if(PANEL(x) == PANEL(x+1)) {
+			copy_matrix_column(shown[x+1], shown[x]);
+		} else {
+			set_matrix_column_to_colour(shown[x], COLOUR_BLACK);
+		}
+	}
+	set_matrix_column_to_colour(frame[MATRIX_NUM_COLUMNS-1], COLOUR_BLACK);
+	set_matrix_column_to_colour(shown[MATRIX_NUM_COLUMNS-1], COLOUR_BLACK);
+	if(MATRIX_NUM_PANELS > 1) {
+		mark_rows_dirty(ALL_ROWS_DIRTY);
+	}
 }
 
 void ledmatrix_shift_display_right(void) {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x01);
+	ledmatrix_flush();
+	send_shift(0x01);
+	for(uint8_t x=MATRIX_NUM_COLUMNS-1; x>0; x--) {
+		copy_matrix_column(frame[x-1], frame[x]);
+		if(PANEL(x) == PANEL(x-1)) {
+			copy_matrix_column(shown[x-1], shown[x]);
+		} else {
+			set_matrix_column_to_colour(shown[x], COLOUR_BLACK);
+		}
+	}
+	set_matrix_column_to_colour(frame[0], COLOUR_BLACK);
+	set_matrix_column_to_colour(shown[0], COLOUR_BLACK);
+	if(MATRIX_NUM_PANELS > 1) {
+		mark_rows_dirty(ALL_ROWS_DIRTY);
+	}
 }
 
 void ledmatrix_shift_display_up(void) {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x08);
+	ledmatrix_flush();
+	send_shift(0x08);
+	for(uint8_t x=0; x<MATRIX_NUM_COLUMNS; x++) {
+		for(uint8_t y=MATRIX_NUM_ROWS-1; y>0; y--) {
+			frame[x][y] = frame[x][y-1];
+			shown[x][y] = shown[x][y-1];
+		}
+		frame[x][0] = COLOUR_BLACK;
+		shown[x][0] = COLOUR_BLACK;
+	}
 }
 
 void ledmatrix_shift_display_down(void) {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x04);
+	ledmatrix_flush();
+	send_shift(0x04);
+	for(uint8_t x=0; x<MATRIX_NUM_COLUMNS; x++) {
+		for(uint8_t y=0; y<MATRIX_NUM_ROWS-1; y++) {
+			frame[x][y] = frame[x][y+1];
+			shown[x][y] = shown[x][y+1];
+		}
+		frame[x][MATRIX_NUM_ROWS-1] = COLOUR_BLACK;
+		shown[x][MATRIX_NUM_ROWS-1] = COLOUR_BLACK;
+	}
 }
 
 void ledmatrix_clear(void) {
-	(void)spi_send_byte(CMD_CLEAR_SCREEN);
+	for(uint8_t x=0; x<MATRIX_NUM_COLUMNS; x++) {
+		set_matrix_column_to_colour(frame[x], COLOUR_BLACK);
+	}
+	mark_rows_dirty(ALL_ROWS_DIRTY);
+}
+
+void ledmatrix_flush(void) {
+	for(uint8_t p=0; p<MATRIX_NUM_PANELS; p++) {
+		if(dirty_rows[p]) {
+			flush_panel(p);
+		}
+	}
+}
+
+void ledmatrix_wait_until_sent(void) {
+	ledmatrix_flush();
+	spi_drain();
+}
+
+uint16_t ledmatrix_frame_time(uint8_t clockdivider, uint8_t paced) {
+	uint32_t start;
+	
+	ledmatrix_wait_until_sent();
+	
+	// Start with a full burst allowance so every run is the same
+	spi_set_pacing(pacing_burst, paced ? pacing_rate : 0);
+	spi_queue_clock(clockdivider);
+	start = get_fine_time();
+	for(uint8_t p=0; p<MATRIX_NUM_PANELS; p++) {
+		spi_queue_select(p);
+		send_all(p);
+	}
+	spi_drain();
+	start = get_fine_time() - start;
+	
+	spi_set_pacing(pacing_burst, pacing_rate);
+	return start;
 }
 
 void copy_matrix_column(MatrixColumn from, MatrixColumn to) {
@@ -114,3 +297,161 @@ void set_matrix_row_to_colour(MatrixRow matrix_row, PixelColour colour) {
 		matrix_row[column] = colour;
 	}
 }
+
+/******** INTERNAL FUNCTIONS ****************/
+
+// Mark the given rows of every panel as dirty
+static void mark_rows_dirty(uint8_t rows) {
+	for(uint8_t p=0; p<MATRIX_NUM_PANELS; p++) {
+		dirty_rows[p] |= rows;
+	}
+}
+
+// Send the changes to the given panel (see ledmatrix_flush())
+static void flush_panel(uint8_t panel) {
+	// changed[y] - bit i is set if pixel (first + i, y) needs to be sent
+	uint16_t changed[MATRIX_NUM_ROWS];
+	uint8_t row_count[MATRIX_NUM_ROWS];
+	uint8_t col_count[MATRIX_PANEL_COLUMNS];
+	uint16_t row_cost = 0;
+	uint16_t col_cost = 0;
+	uint8_t all_rows_dirty = (dirty_rows[panel] == ALL_ROWS_DIRTY);
+	uint8_t first = FIRST_COLUMN(panel);
+	uint8_t i, y, cost;
+	
+	// Work out which pixels have changed and how many bytes it would
+	// take to send them row by row or column by column. (Each row or
+	// column is sent with either pixel updates or a single row/column
+	// update - whichever is shorter.)
+	for(i=0; i<MATRIX_PANEL_COLUMNS; i++) {
+		col_count[i] = 0;
+	}
+	for(y=0; y<MATRIX_NUM_ROWS; y++) {
+		changed[y] = 0;
+		row_count[y] = 0;
+		if(dirty_rows[panel] & (1 << y)) {
+			for(i=0; i<MATRIX_PANEL_COLUMNS; i++) {
+				if(frame[first+i][y] != shown[first+i][y]) {
+					changed[y] |= ((uint16_t)1 << i);
+					row_count[y]++;
+					col_count[i]++;
+				}
+			}
+		}
+		cost = row_count[y] * CMD_UPDATE_PIXEL_BYTES;
+		row_cost += (cost < CMD_UPDATE_ROW_BYTES) ? cost : CMD_UPDATE_ROW_BYTES;
+	}
+	dirty_rows[panel] = 0;
+	
+	if(row_cost == 0) {
+		// Pixels were written but they ended up unchanged
+		return;
+	}
+	for(i=0; i<MATRIX_PANEL_COLUMNS; i++) {
+		cost = col_count[i] * CMD_UPDATE_PIXEL_BYTES;
+		col_cost += (cost < CMD_UPDATE_COL_BYTES) ? cost : CMD_UPDATE_COL_BYTES;
+	}
+	
+	// Send the changes using the cheapest approach
+	spi_queue_select(panel);
+	if(all_rows_dirty && panel_is_blank(panel)) {
+		spi_queue_clock(LEDMATRIX_COMMAND_DIVIDER);
+		send_clear(panel);
+		return;
+	}
+	spi_queue_clock(LEDMATRIX_DATA_DIVIDER);
+	if(CMD_UPDATE_ALL_BYTES <= row_cost && 
+			CMD_UPDATE_ALL_BYTES <= col_cost) {
+		send_all(panel);
+	} else if(row_cost <= col_cost) {
+		for(y=0; y<MATRIX_NUM_ROWS; y++) {
+			if(row_count[y] * CMD_UPDATE_PIXEL_BYTES >= CMD_UPDATE_ROW_BYTES) {
+				send_row(panel, y);
+			} else {
+				for(i=0; changed[y]; i++, changed[y] >>= 1) {
+					if(changed[y] & 1) {
+						send_pixel(first+i, y);
+					}
+				}
+			}
+		}
+	} else {
+		for(i=0; i<MATRIX_PANEL_COLUMNS; i++) {
+			if(col_count[i] * CMD_UPDATE_PIXEL_BYTES >= CMD_UPDATE_COL_BYTES) {
+				send_column(first+i);
+			} else if(col_count[i]) {
+				for(y=0; y<MATRIX_NUM_ROWS; y++) {
+					if(changed[y] & ((uint16_t)1 << i)) {
+						send_pixel(first+i, y);
+					}
+				}
+			}
+		}
+	}
+}
+
+// Send a shift command to every panel
+static void send_shift(uint8_t direction) {
+	spi_queue_clock(LEDMATRIX_COMMAND_DIVIDER);
+	for(uint8_t p=0; p<MATRIX_NUM_PANELS; p++) {
+		spi_queue_select(p);
+		spi_queue_byte(CMD_SHIFT_DISPLAY);
+		spi_queue_byte(direction);
+	}
+}
+
+// Each of the send functions below sends the relevant part of the
+// frame to the LED matrix and records that it is now shown. The 
+// panel must already be selected. (The commands take column numbers
+// within the panel - x & 0x0F - since a panel is 16 columns wide.)
+
+static void send_pixel(uint8_t x, uint8_t y) {
+	uint8_t command[CMD_UPDATE_PIXEL_BYTES] = 
+			{ CMD_UPDATE_PIXEL, ((y & 0x07)<<4) | (x & 0x0F), frame[x][y] };
+	spi_queue_bytes(command, CMD_UPDATE_PIXEL_BYTES);
+	shown[x][y] = frame[x][y];
+}
+
+static void send_row(uint8_t panel, uint8_t y) {
+	spi_queue_byte(CMD_UPDATE_ROW);
+	spi_queue_byte(y & 0x07);	// row number
+	for(uint8_t x = FIRST_COLUMN(panel); x<FIRST_COLUMN(panel+1); x++) {
+		spi_queue_byte(frame[x][y]);
+		shown[x][y] = frame[x][y];
+	}
+}
+
+static void send_column(uint8_t x) {
+	spi_queue_byte(CMD_UPDATE_COL);
+	spi_queue_byte(x & 0x0F); // column number
+	spi_queue_bytes(frame[x], MATRIX_NUM_ROWS);
+	copy_matrix_column(frame[x], shown[x]);
+}
+
+static void send_all(uint8_t panel) {
+	spi_queue_byte(CMD_UPDATE_ALL);
+	for(uint8_t y=0; y<MATRIX_NUM_ROWS; y++) {
+		for(uint8_t x = FIRST_COLUMN(panel); x<FIRST_COLUMN(panel+1); x++) {
+			spi_queue_byte(frame[x][y]);
+			shown[x][y] = frame[x][y];
+		}
+	}
+}
+
+static void send_clear(uint8_t panel) {
+	spi_queue_byte(CMD_CLEAR_SCREEN);
+	for(uint8_t x = FIRST_COLUMN(panel); x<FIRST_COLUMN(panel+1); x++) {
+		set_matrix_column_to_colour(shown[x], COLOUR_BLACK);
+	}
+}
+
+static uint8_t panel_is_blank(uint8_t panel) {
+	for(uint8_t x = FIRST_COLUMN(panel); x<FIRST_COLUMN(panel+1); x++) {
+		for(uint8_t y=0; y<MATRIX_NUM_ROWS; y++) {
+			if(frame[x][y] != COLOUR_BLACK) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
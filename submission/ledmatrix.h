@@ -11,10 +11,17 @@
 #include <stdint.h>
 #include "pixel_colour.h"
 
-// The matrix has 16 columns (x ranges from 0 to 15, left to right) and 
-// 8 rows (y ranges from 0 to 7, bottom to top) - as per the X,Y
-// coordinates marked on the board.
-#define MATRIX_NUM_COLUMNS 16
+// Each LED matrix board (panel) has 16 columns and 8 rows. The display 
+// is made up of MATRIX_NUM_PANELS panels side by side, panel 0 on the
+// left, so x ranges from 0 to MATRIX_NUM_COLUMNS - 1 (left to right)
+// and y ranges from 0 to 7 (bottom to top) - on a single panel these 
+// are the X,Y coordinates marked on the board. Panel p is SPI device p
+// (see spi.h), so SPI_NUM_DEVICES must be at least MATRIX_NUM_PANELS.
+#ifndef MATRIX_NUM_PANELS
+#define MATRIX_NUM_PANELS 1
+#endif
+#define MATRIX_PANEL_COLUMNS 16
+#define MATRIX_NUM_COLUMNS (MATRIX_PANEL_COLUMNS * MATRIX_NUM_PANELS)
 #define MATRIX_NUM_ROWS 8
 
 // Data types which can be used to store display information
@@ -22,17 +29,78 @@ typedef PixelColour MatrixData[MATRIX_NUM_COLUMNS][MATRIX_NUM_ROWS];
 typedef PixelColour MatrixRow[MATRIX_NUM_COLUMNS];
 typedef PixelColour MatrixColumn[MATRIX_NUM_ROWS];
 
+// Pixel addresses - a single number (0 to 128 x MATRIX_NUM_PANELS - 1)
+// for each (x,y) position on the matrix, for use with 
+// ledmatrix_update_pixel_at(). Tables of addresses (see game.h) let 
+// callers skip the coordinate arithmetic.
+#define MATRIX_ADDRESS(x, y)	((x) * MATRIX_NUM_ROWS + (y))
+#define MATRIX_ADDRESS_X(address)	((address) / MATRIX_NUM_ROWS)
+#define MATRIX_ADDRESS_Y(address)	((address) % MATRIX_NUM_ROWS)
+#if MATRIX_NUM_PANELS <= 2
+typedef uint8_t MatrixAddress;
+#define pgm_read_matrix_address(p)	pgm_read_byte(p)
+#else
+typedef uint16_t MatrixAddress;
+#define pgm_read_matrix_address(p)	pgm_read_word(p)
+#endif
+
 // Setup SPI communication with the LED matrix.
 // This function must be called before the LED matrix functions
 // below are used.
 void ledmatrix_setup(void);
 
+// Measure the rate at which a full frame is sent with the data divider
+// and pace the LED matrix's transfers at that rate from now on (see
+// LEDMATRIX_BYTES_PER_MS). Interrupts and timer 0 must be running.
+void ledmatrix_calibrate(void);
+
+// Returns the average rate (bytes per ms) the LED matrix's transfers 
+// are being paced at, or 0 if they aren't paced
+uint8_t ledmatrix_bytes_per_ms(void);
+
+// SPI speeds. Pixel data (the update all, row, column and pixel 
+// commands) is sent using the LEDMATRIX_DATA_DIVIDER clock divider and 
+// the commands the LED matrix has to act on straight away (shift and 
+// clear) using LEDMATRIX_COMMAND_DIVIDER. A byte takes the divider's
+// value in microseconds on the wire, so a full frame (129 bytes per 
+// panel) takes 16.5ms at divider 128, 8.3ms at 64, 4.1ms at 32 and 
+// 2.1ms at 16 - plus the interrupt overhead for each byte, which is 
+// what limits the faster dividers. The data divider must be one which
+// MATRIX_BENCHMARK (see project.c) shows sending whole frames back to
+// back without corrupting the display.
+//
+// The bytes are paced (see spi_set_pacing()) so that after a burst of
+// LEDMATRIX_BURST_BYTES they average LEDMATRIX_BYTES_PER_MS. If that 
+// is 0 (the default) the rate is measured instead by 
+// ledmatrix_calibrate() - it's the rate a full frame actually goes 
+// out at with the data divider, so pixel data is never held below the
+// speed the divider was checked at.
+#ifndef LEDMATRIX_DATA_DIVIDER
+#define LEDMATRIX_DATA_DIVIDER 32
+#endif
+#ifndef LEDMATRIX_COMMAND_DIVIDER
+#define LEDMATRIX_COMMAND_DIVIDER 128
+#endif
+#ifndef LEDMATRIX_BURST_BYTES
+#define LEDMATRIX_BURST_BYTES 16
+#endif
+#ifndef LEDMATRIX_BYTES_PER_MS
+#define LEDMATRIX_BYTES_PER_MS 0
+#endif
+
 // Functions to update the display
 // For those functions which take an x or a y value, the value must be valid
 // or the request will be ignored. (i.e. x must be < MATRIX_NUM_COLUMNS
 // and y must be < MATRIX_NUM_ROWS)
+// These functions update a shadow copy of the display in RAM - the
+// changes are not sent to the LED matrix until ledmatrix_flush() is
+// called. (The shift functions are the exception - these flush any
+// pending changes and are sent immediately.)
 void ledmatrix_update_all(MatrixData data);
 void ledmatrix_update_pixel(uint8_t x, uint8_t y, PixelColour pixel);
+// As ledmatrix_update_pixel() but with the position given as a pixel
+// address. The address must be valid - it isn't checked.
+void ledmatrix_update_pixel_at(MatrixAddress address, PixelColour pixel);
 void ledmatrix_update_row(uint8_t y, MatrixRow row);
 void ledmatrix_update_column(uint8_t x, MatrixColumn col);
 void ledmatrix_shift_display_left(void);
@@ -41,6 +109,26 @@ void ledmatrix_shift_display_up(void);
 void ledmatrix_shift_display_down(void);
 void ledmatrix_clear(void);
 
+// Send any changes made to the display since the last flush. Only pixels
+// which differ from what was last sent are output, using whichever
+// combination of pixel, row, column or whole display updates needs
+// the fewest SPI bytes. Pixels which are changed and then changed back
+// before a flush cost nothing. Each panel is dealt with separately -
+// panels with no changes are not sent anything.
+void ledmatrix_flush(void);
+
+// Flush any pending changes and wait until they have all been sent
+// to the LED matrix. (The functions above return once their SPI
+// commands have been queued - they do not wait for them to be sent.)
+void ledmatrix_wait_until_sent(void);
+
+// Send the whole display to every panel using the given SPI clock 
+// divider (one of 2,4,8,16,32,64,128), with or without pacing, and 
+// return the time it took in timer0 counts (see get_fine_time()). 
+// Pending changes are sent first and aren't included. This waits for
+// the SPI transfers, so interrupts must be enabled.
+uint16_t ledmatrix_frame_time(uint8_t clockdivider, uint8_t paced);
+
 // Functions to operate on MatrixRow and MatrixColumn data structures
 void copy_matrix_column(MatrixColumn from, MatrixColumn to);
 void copy_matrix_row(MatrixRow from, MatrixRow to);
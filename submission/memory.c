@@ -0,0 +1,164 @@
+/*
+ * memory.c
+ *
+ * Author: Alex Patapan
+ *
+ * The symbols used here are defined by the avr-libc linker script:
+ * __data_start/__data_end and __bss_start/__bss_end bound the 
+ * initialised and zeroed static data, __heap_start is the first byte
+ * after them (we don't use malloc() so the heap is unused) and 
+ * __data_load_end is the end of the program image in flash.
+ */
+
+#include <stdio.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include "memory.h"
+#include "terminalio.h"
+
+#define STACK_CANARY 0xC5
+
+extern uint8_t __data_start;
+extern uint8_t __data_end;
+extern uint8_t __bss_start;
+extern uint8_t __bss_end;
+extern uint8_t __heap_start;
+extern uint8_t __data_load_end;
+
+// Module usage records (see MEMORY_USAGE())
+extern const MemoryUsage game_memory PROGMEM;
+extern const MemoryUsage ledmatrix_memory PROGMEM;
+extern const MemoryUsage spi_memory PROGMEM;
+extern const MemoryUsage serialio_memory PROGMEM;
+extern const MemoryUsage scrolling_memory PROGMEM;
+extern const MemoryUsage replay_memory PROGMEM;
+extern const MemoryUsage animation_memory PROGMEM;
+extern const MemoryUsage scheduler_memory PROGMEM;
+extern const MemoryUsage profiler_memory PROGMEM;
+extern const MemoryUsage buttons_memory PROGMEM;
+extern const MemoryUsage sound_memory PROGMEM;
+extern const MemoryUsage input_decoder_memory PROGMEM;
+extern const MemoryUsage telemetry_memory PROGMEM;
+extern const MemoryUsage highscores_memory PROGMEM;
+extern const MemoryUsage joystick_memory PROGMEM;
+extern const MemoryUsage terminal_status_memory PROGMEM;
+extern const MemoryUsage timer0_memory PROGMEM;
+extern const MemoryUsage score_memory PROGMEM;
+extern const MemoryUsage prng_memory PROGMEM;
+
+typedef struct {
+	PGM_P name;
+	const MemoryUsage* usage;
+} ModuleEntry;
+
+static const char name_game[] PROGMEM = "game";
+static const char name_ledmatrix[] PROGMEM = "ledmatrix";
+static const char name_spi[] PROGMEM = "spi";
+static const char name_serialio[] PROGMEM = "serialio";
+static const char name_scrolling[] PROGMEM = "scrolling text";
+static const char name_replay[] PROGMEM = "replay";
+static const char name_animation[] PROGMEM = "animation";
+static const char name_scheduler[] PROGMEM = "scheduler";
+static const char name_profiler[] PROGMEM = "profiler";
+static const char name_buttons[] PROGMEM = "buttons";
+static const char name_sound[] PROGMEM = "sound";
+static const char name_input_decoder[] PROGMEM = "input decoder";
+static const char name_telemetry[] PROGMEM = "telemetry";
+static const char name_highscores[] PROGMEM = "high scores";
+static const char name_joystick[] PROGMEM = "joystick";
+static const char name_terminal_status[] PROGMEM = "terminal status";
+static const char name_timer0[] PROGMEM = "timer0";
+static const char name_score[] PROGMEM = "score";
+static const char name_prng[] PROGMEM = "prng";
+
+static const ModuleEntry modules[] PROGMEM = {
+		{ name_game, &game_memory },
+		{ name_ledmatrix, &ledmatrix_memory },
+		{ name_spi, &spi_memory },
+		{ name_serialio, &serialio_memory },
+		{ name_scrolling, &scrolling_memory },
+		{ name_replay, &replay_memory },
+		{ name_animation, &animation_memory },
+		{ name_scheduler, &scheduler_memory },
+		{ name_profiler, &profiler_memory },
+		{ name_buttons, &buttons_memory },
+		{ name_sound, &sound_memory },
+		{ name_input_decoder, &input_decoder_memory },
+		{ name_telemetry, &telemetry_memory },
+		{ name_highscores, &highscores_memory },
+		{ name_joystick, &joystick_memory },
+		{ name_terminal_status, &terminal_status_memory },
+		{ name_timer0, &timer0_memory },
+		{ name_score, &score_memory },
+		{ name_prng, &prng_memory } };
+
+#define NUM_MODULES (sizeof(modules) / sizeof(modules[0]))
+
+/* Paint the stack. This runs from the .init1 section - after reset 
+ * but before the C runtime has set up the stack pointer, cleared r1 
+ * or initialised the static data - so it must be naked and written 
+ * in assembler (it can't rely on anything the compiler expects). It
+ * fills every byte from __heap_start up to RAMEND.
+ */
+void memory_paint_stack(void) __attribute__((naked, used, section(".init1")));
+
+void memory_paint_stack(void) {
+	__asm__ volatile (
+			"	ldi r30, lo8(__heap_start)\n"
+			"	ldi r31, hi8(__heap_start)\n"
+			"	ldi r24, %0\n"
+			"	ldi r25, hi8(%1)\n"
+			"	rjmp 2f\n"
+			"1:	st Z+, r24\n"
+			"2:	cpi r30, lo8(%1)\n"
+			"	cpc r31, r25\n"
+			"	brlo 1b\n"
+			"	breq 1b\n"
+			: 
+			: "M" (STACK_CANARY), "i" (RAMEND));
+}
+
+uint16_t memory_stack_unused(void) {
+	const uint8_t* p = &__heap_start;
+	
+	// The stack grows down from RAMEND so the untouched bytes are 
+	// at the bottom
+	while(p <= (const uint8_t*)RAMEND && *p == STACK_CANARY) {
+		p++;
+	}
+	return p - &__heap_start;
+}
+
+uint16_t memory_free_now(void) {
+	return SP - (uint16_t)&__heap_start;
+}
+
+uint8_t memory_report(int8_t row) {
+	uint16_t stackSize = RAMEND + 1 - (uint16_t)&__heap_start;
+	uint16_t unused = memory_stack_unused();
+	const MemoryUsage* usage;
+	
+	move_cursor(1, row);
+	clear_to_end_of_line();
+	printf_P(PSTR("SRAM %u: data %u, bss %u, stack max %u of %u (free now %u)"), 
+			RAMEND + 1 - RAMSTART, 
+			(uint16_t)(&__data_end - &__data_start),
+			(uint16_t)(&__bss_end - &__bss_start), 
+			stackSize - unused, stackSize, memory_free_now());
+	move_cursor(1, row + 1);
+	clear_to_end_of_line();
+	printf_P(PSTR("flash used %u"), (uint16_t)&__data_load_end);
+	
+	move_cursor(1, row + 2);
+	printf_P(PSTR("%-16S%8S%8S"), PSTR("module"), PSTR("ram"), 
+			PSTR("flash"));
+	for(uint8_t i = 0; i < NUM_MODULES; i++) {
+		usage = (const MemoryUsage*)pgm_read_word(&modules[i].usage);
+		move_cursor(1, row + 3 + i);
+		clear_to_end_of_line();
+		printf_P(PSTR("%-16S%8u%8u"), (PGM_P)pgm_read_word(&modules[i].name),
+				pgm_read_word(&usage->ram), pgm_read_word(&usage->flash));
+	}
+	return NUM_MODULES + 3;
+}
@@ -0,0 +1,48 @@
+/*
+ * memory.h
+ *
+ * Author: Alex Patapan
+ *
+ * SRAM instrumentation. At reset (before main and before the stack
+ * is in use) the memory between the end of the static data and the
+ * top of SRAM is painted with a canary value. Stack which has ever
+ * been used no longer holds the canary, so the untouched bytes at the
+ * bottom give the stack high-water mark. memory_report() outputs this
+ * along with the sizes of the static data and how much of it each
+ * module uses.
+ *
+ * Modules record their static usage with MEMORY_USAGE() (at file 
+ * scope in the module's .c file), e.g.
+ *		MEMORY_USAGE(spi, sizeof(spi_queue) + 3, 0);
+ * and are listed in the table in memory.c.
+ */
+
+#ifndef MEMORY_H_
+#define MEMORY_H_
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+// Bytes of static data in SRAM and of constant tables in program
+// memory (PROGMEM) used by a module
+typedef struct {
+	uint16_t ram;
+	uint16_t flash;
+} MemoryUsage;
+
+#define MEMORY_USAGE(module, ramBytes, flashBytes) \
+		const MemoryUsage module##_memory PROGMEM = { (ramBytes), (flashBytes) }
+
+// Returns the number of bytes of stack that have never been used
+// since reset, i.e. the headroom left at the deepest point so far
+uint16_t memory_stack_unused(void);
+
+// Returns the number of bytes between the end of the static data and
+// the current stack pointer
+uint16_t memory_free_now(void);
+
+// Output the memory summary and per module usage to the terminal, 
+// starting at the given row. Returns the number of rows output.
+uint8_t memory_report(int8_t row);
+
+#endif /* MEMORY_H_ */
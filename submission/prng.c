@@ -0,0 +1,51 @@
+/*
+ * prng.c
+ *
+ * Author: Alex Patapan
+ *
+ * xorshift with shifts (7, 9, 8), which steps through every non-zero 
+ * 16 bit value before repeating. The state must never be zero (zero
+ * maps to itself).
+ */
+
+#include "prng.h"
+#include "memory.h"
+
+#define DEFAULT_SEED 0xACE1
+
+static uint16_t state = DEFAULT_SEED;
+
+// Static data used by this module (see memory.h)
+MEMORY_USAGE(prng, sizeof(state), 0);
+
+void prng_seed(uint16_t seed) {
+	state = seed ? seed : DEFAULT_SEED;
+}
+
+uint16_t prng_next(void) {
+	state ^= state << 7;
+	state ^= state >> 9;
+	state ^= state << 8;
+	return state;
+}
+
+uint8_t prng_range(uint8_t limit) {
+	// Scale the top 8 bits of the next number into the range - this
+	// is a single 8 bit multiply rather than a division. (The results 
+	// are evenly spread to within 1 in 256.)
+	uint8_t top = prng_next() >> 8;
+	return ((uint16_t)top * limit) >> 8;
+}
+
+uint16_t prng_range16(uint16_t limit) {
+	// As above but with all 16 bits, for ranges above 255
+	return ((uint32_t)prng_next() * limit) >> 16;
+}
+
+uint16_t prng_get_state(void) {
+	return state;
+}
+
+void prng_set_state(uint16_t new_state) {
+	prng_seed(new_state);
+}
@@ -0,0 +1,34 @@
+/*
+ * prng.h
+ *
+ * Author: Alex Patapan
+ *
+ * Pseudo random number generator for the game. This is a 16 bit 
+ * xorshift generator - cheap to run on the AVR and, because its state
+ * is just one number, easy to seed, save and restore (so that a game 
+ * can be replayed exactly).
+ */
+
+#ifndef PRNG_H_
+#define PRNG_H_
+
+#include <stdint.h>
+
+// Start a new sequence of numbers. Any seed may be used (0 is replaced
+// by a fixed non-zero seed). The same seed always gives the same 
+// sequence.
+void prng_seed(uint16_t seed);
+
+// Return the next number in the sequence (1 to 65535)
+uint16_t prng_next(void);
+
+// Return a number from 0 to limit - 1 (limit must be at least 1)
+uint8_t prng_range(uint8_t limit);
+uint16_t prng_range16(uint16_t limit);
+
+// Get and set the generator state. Setting a state previously got
+// continues the sequence from that point.
+uint16_t prng_get_state(void);
+void prng_set_state(uint16_t state);
+
+#endif /* PRNG_H_ */
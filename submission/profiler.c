@@ -0,0 +1,140 @@
+/*
+ * profiler.c
+ *
+ * Author: Alex Patapan
+ *
+ * Times are recorded in timer0 counts (64 clock cycles each) to keep
+ * the markers cheap and are only converted to clock cycles when the 
+ * report is output.
+ */
+
+#include <stdio.h>
+#include <avr/pgmspace.h>
+
+#include "profiler.h"
+#include "timer0.h"
+#include "terminalio.h"
+#include "memory.h"
+
+typedef struct {
+	uint32_t start;
+	uint32_t total;
+	uint16_t min;
+	uint16_t max;
+	uint16_t count;
+} SectionStats;
+
+static SectionStats sections[PROF_NUM_SECTIONS];
+
+// Time (in timer0 counts) at which profiling started, at which the
+// current sleep started and spent asleep in total, and the number of 
+// times we've woken up
+static uint32_t profile_start;
+static uint32_t sleep_start;
+static uint32_t sleep_total;
+static uint32_t wakes;
+
+static const char name_asteroids[] PROGMEM = "asteroids";
+static const char name_projectiles[] PROGMEM = "projectiles";
+static const char name_input[] PROGMEM = "input";
+static const char name_joystick[] PROGMEM = "joystick";
+static const char name_animation[] PROGMEM = "animation";
+static const char name_matrix[] PROGMEM = "matrix flush";
+static const char name_terminal[] PROGMEM = "terminal flush";
+
+static PGM_P const section_names[PROF_NUM_SECTIONS] PROGMEM = {
+		name_asteroids, name_projectiles, name_input, name_joystick,
+		name_animation, name_matrix, name_terminal };
+
+// Static data used by this module (see memory.h)
+MEMORY_USAGE(profiler, sizeof(sections) + sizeof(profile_start) + 
+		sizeof(sleep_start) + sizeof(sleep_total) + sizeof(wakes), 
+		sizeof(name_asteroids) + 
+		sizeof(name_projectiles) + sizeof(name_input) + sizeof(name_joystick) +
+		sizeof(name_animation) + sizeof(name_matrix) + sizeof(name_terminal) +
+		sizeof(section_names));
+
+void profile_init(void) {
+	for(uint8_t i=0; i < PROF_NUM_SECTIONS; i++) {
+		sections[i].total = 0;
+		sections[i].min = UINT16_MAX;
+		sections[i].max = 0;
+		sections[i].count = 0;
+	}
+	sleep_total = 0;
+	wakes = 0;
+	profile_start = get_fine_time();
+}
+
+void profile_begin(ProfileSection section) {
+	sections[section].start = get_fine_time();
+}
+
+void profile_end(ProfileSection section) {
+	SectionStats* stats = &sections[section];
+	uint32_t elapsed = get_fine_time() - stats->start;
+	uint16_t time = (elapsed > UINT16_MAX) ? UINT16_MAX : (uint16_t)elapsed;
+	
+	if(stats->count == UINT16_MAX) {
+		// Stop counting rather than wrapping around
+		return;
+	}
+	stats->count++;
+	stats->total += time;
+	if(time < stats->min) {
+		stats->min = time;
+	}
+	if(time > stats->max) {
+		stats->max = time;
+	}
+}
+
+void profile_sleep_begin(void) {
+	sleep_start = get_fine_time();
+}
+
+void profile_sleep_end(void) {
+	sleep_total += get_fine_time() - sleep_start;
+	wakes++;
+}
+
+uint16_t profile_count(ProfileSection section) {
+	return sections[section].count;
+}
+
+void profile_report(int8_t row) {
+	SectionStats* stats;
+	uint32_t elapsed = get_fine_time() - profile_start;
+	uint32_t awake = elapsed - sleep_total;
+	
+	move_cursor(1, row);
+	printf_P(PSTR("%-16S%8S%10S%10S%10S"), PSTR("section"), PSTR("calls"),
+			PSTR("min"), PSTR("mean"), PSTR("max"));
+	for(uint8_t i=0; i < PROF_NUM_SECTIONS; i++) {
+		stats = &sections[i];
+		move_cursor(1, row + 1 + i);
+		clear_to_end_of_line();
+		printf_P(PSTR("%-16S%8u"), (PGM_P)pgm_read_word(&section_names[i]), 
+				stats->count);
+		if(stats->count) {
+			printf_P(PSTR("%10lu%10lu%10lu"), 
+					(uint32_t)stats->min * TIMER0_CYCLES_PER_COUNT,
+					(stats->total / stats->count) * TIMER0_CYCLES_PER_COUNT,
+					(uint32_t)stats->max * TIMER0_CYCLES_PER_COUNT);
+		}
+	}
+	
+	// Duty cycle in tenths of a percent (in 64 bit arithmetic so that
+	// long runs don't overflow - this is only done for a report)
+	move_cursor(1, row + 1 + PROF_NUM_SECTIONS);
+	clear_to_end_of_line();
+	if(elapsed) {
+		awake = (uint32_t)((uint64_t)awake * 1000 / elapsed);
+		if(awake > 1000) {
+			awake = 1000;
+		}
+		printf_P(PSTR("awake %lu.%lu%%, %lu wakes in %lu s"), 
+				awake / 10, awake % 10, wakes, 
+				elapsed / (TIMER0_COUNTS_PER_MS * 1000UL));
+	}
+}
@@ -0,0 +1,86 @@
+/*
+ * profiler.h
+ *
+ * Author: Alex Patapan
+ *
+ * Simple section profiler. Code to be measured is wrapped in 
+ * PROF_BEGIN(section) and PROF_END(section) markers. For each section
+ * we record the number of times it ran and the minimum, maximum and
+ * mean time it took (measured with timer0 - see get_fine_time()).
+ * We also record how long the CPU spends asleep waiting for interrupts
+ * (see scheduler.c), which gives the duty cycle - the fraction of the
+ * time we're awake - and the number of times we've woken up. 
+ * profile_report() outputs a table of the results to the terminal.
+ *
+ * Set PROFILING to 0 to compile the markers out completely.
+ */
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <stdint.h>
+
+#ifndef PROFILING
+#define PROFILING 1
+#endif
+
+/* The sections we measure. If changing these, also change the 
+ * section names in profiler.c.
+ */
+typedef enum {
+	PROF_ADVANCE_ASTEROIDS,
+	PROF_ADVANCE_PROJECTILES,
+	PROF_INPUT,
+	PROF_JOYSTICK,
+	PROF_ANIMATION,
+	PROF_MATRIX_FLUSH,
+	PROF_TERMINAL_FLUSH,
+	PROF_NUM_SECTIONS
+} ProfileSection;
+
+#if PROFILING
+#define PROF_BEGIN(section)	profile_begin(section)
+#define PROF_END(section)	profile_end(section)
+#define PROF_SLEEP_BEGIN()	profile_sleep_begin()
+#define PROF_SLEEP_END()	profile_sleep_end()
+#else
+#define PROF_BEGIN(section)	((void)0)
+#define PROF_END(section)	((void)0)
+#define PROF_SLEEP_BEGIN()	((void)0)
+#define PROF_SLEEP_END()	((void)0)
+#endif
+
+/* Number of terminal rows output by profile_report()
+ */
+#define PROFILE_REPORT_ROWS (PROF_NUM_SECTIONS + 2)
+
+/* Clear all recorded results.
+ */
+void profile_init(void);
+
+/* Mark the start and end of a section. (Use the macros above rather
+ * than calling these directly.) Sections may be nested inside other
+ * sections but a section must not be nested inside itself.
+ */
+void profile_begin(ProfileSection section);
+void profile_end(ProfileSection section);
+
+/* Mark the start and end of a period of sleep. (Again, use the macros
+ * above.)
+ */
+void profile_sleep_begin(void);
+void profile_sleep_end(void);
+
+/* Output the results to the terminal, starting at the given row. 
+ * Times are in clock cycles. The duty cycle and wake count cover the 
+ * time since profile_init(). This waits for the output to be 
+ * buffered so should only be used on demand.
+ */
+void profile_report(int8_t row);
+
+/* Return the number of times the given section has run (this stops 
+ * at 65535).
+ */
+uint16_t profile_count(ProfileSection section);
+
+#endif /* PROFILER_H_ */
@@ -15,15 +15,26 @@
 #include "ledmatrix.h"
 #include "scrolling_char_display.h"
 #include "buttons.h"
+#include "joystick.h"
+#include "sound.h"
+#include "prng.h"
+#include "animation.h"
+#include "replay.h"
+#include "input_decoder.h"
 #include "serialio.h"
 #include "terminalio.h"
+#include "terminal_status.h"
+#include "telemetry.h"
 #include "score.h"
+#include "highscores.h"
 #include "timer0.h"
+#include "scheduler.h"
+#include "profiler.h"
+#include "memory.h"
 #include "game.h"
 #include "pixel_colour.h"
 
 #define F_CPU 8000000L
-#include <util/delay.h>
 
 // Function prototypes - these are defined below (after main()) in the order
 // given here
@@ -31,35 +42,73 @@ void initialise_hardware(void);
 void splash_screen(void);
 void new_game(void);
 void play_game(void);
+void pause_game(void);
+void resume_game(void);
 void handle_game_over(void);
 void seven_segment_ports(void);
 
 void update_terminal(void);
-void advance_asteroids(void);
-void play_sound(uint16_t);
-void handle_basehit_sound(void);
-void handle_asteroid_animation(int x, int y);
-void enable_asteroid_animation(int x, int y);
-void redraw_base(uint8_t colour);
-void redraw_all_asteroids(void);
-void redraw_all_projectiles(void);
-void explosion(int x, int y, PixelColour colour);
 
+// The program is always in one of these states. The main loop just
+// runs the scheduler - the tasks set up on entering a state do the
+// work, and call request_state() to move to another state. The change
+// is made (by enter_state()) between passes of the scheduler.
+typedef enum {
+	STATE_SPLASH,
+	STATE_PLAYING,
+	STATE_PAUSED,
+	STATE_GAME_OVER
+} GameState;
+static GameState game_state;
+static GameState next_state;
 
-// ASCII code for Escape character
-#define ESCAPE_CHAR 27
+static void request_state(GameState state);
+static void enter_state(GameState state);
+static void toggle_output_mode(void);
 
-//global vars
-uint32_t start_shoot_time, start_hit_time, asteroid_animation_time;
-int startup, sequence, base_hit_sound;
+static void splash_input(void);
+#if MATRIX_BENCHMARK
+static void matrix_benchmark(void);
+#endif
+static void scroll_message(void);
+static void game_over_input(void);
+static void game_over_pattern(void);
+static void game_over_ticker(void);
 
-int basehit_sequence;
-uint32_t basehit_time;
+// Game over screen state - the next column of the pattern to be drawn
+// (or GAME_OVER_TICKER when the score is scrolling) and the colour 
+// arrangement
+#define GAME_OVER_TICKER 255
+static uint8_t gameover_sequence;
+static uint8_t gameover_arrangement;
 
-int animation_x;
-int animation_y;
-int asteroid_animation_on;
-int asteroid_sequence;
+// Random number seed of the current game and whether the next game is
+// to be a replay of the last one
+static uint16_t game_seed;
+static uint8_t replay_requested;
+
+
+// Time (ms) between repeated moves/shots while the joystick is held
+#define JOYSTICK_REPEAT 100
+
+// Terminal row at which the replay log is output
+#define REPLAY_EXPORT_ROW 17
+
+// Terminal row at which the profiling results are output (below
+// the game status)
+#define PROFILE_REPORT_ROW 18
+
+// Set MATRIX_BENCHMARK to 1 to time a full LED matrix update at each 
+// SPI clock divider on the splash screen (see ledmatrix.h) - used to
+// choose LEDMATRIX_DATA_DIVIDER
+#ifndef MATRIX_BENCHMARK
+#define MATRIX_BENCHMARK 0
+#endif
+#define MATRIX_BENCHMARK_ROW 18
+
+// Position of the high score table on the splash and game over screens
+#define HIGH_SCORE_X 64
+#define HIGH_SCORE_Y 10
 
 /////////////////////////////// main //////////////////////////////////
 int main(void) {
@@ -67,14 +116,60 @@ int main(void) {
 	// interrupts.
 	initialise_hardware();
 	
-	// Show the splash screen message. Returns when display
-	// is complete
-	splash_screen();
-	
+	// Start with the splash screen message. From then on everything
+	// happens in the scheduler's tasks.
+	enter_state(STATE_SPLASH);
 	while(1) {
-		new_game();
-		play_game();
-		handle_game_over();
+		scheduler_run();
+		if(next_state != game_state) {
+			enter_state(next_state);
+		}
+	}
+}
+
+// Ask for the state to be changed once the current scheduler pass 
+// is finished
+static void request_state(GameState state) {
+	next_state = state;
+}
+
+static void enter_state(GameState state) {
+	GameState previous_state = game_state;
+	
+	game_state = next_state = state;
+	telemetry_set_state(state);
+	switch(state) {
+		case STATE_SPLASH:
+			splash_screen();
+			break;
+		case STATE_PLAYING:
+			if(previous_state == STATE_PAUSED) {
+				resume_game();
+			} else {
+				new_game();
+				play_game();
+			}
+			break;
+		case STATE_PAUSED:
+			pause_game();
+			break;
+		case STATE_GAME_OVER:
+			handle_game_over();
+			break;
+	}
+}
+
+// Switch the serial output between the text UI and binary telemetry
+// (see telemetry.h). When going back to text the game status is 
+// output again from scratch.
+static void toggle_output_mode(void) {
+	if(serial_is_binary()) {
+		serial_set_binary(0);
+		clear_terminal();
+		terminal_status_init();
+	} else {
+		serial_set_binary(1);
+		telemetry_init();
 	}
 }
 
@@ -85,19 +180,26 @@ void initialise_hardware(void) {
 	// of incoming characters
 	init_serial_stdio(19200,0);
 	
+	// Load the high score table
+	highscores_init();
+	
 	init_timer0();
+	init_sound();
+	profile_init();
 	
 	
 	// Turn on global interrupts
 	sei();
+	
+	// Measure how fast the LED matrix can be sent to (this needs the
+	// timer and interrupts)
+	ledmatrix_calibrate();
 
 	//Setup seven segment display
 	seven_segment_ports();
 	
-	// set up ADC - AVCC reference, right adjust
-	ADMUX = (1<<REFS0);
-	// turn on ADC
-	ADCSRA = (1 << ADEN)|(1<<ADPS2)|(1<<ADPS1);
+	// Start sampling the joystick
+	init_joystick();
 	
 	//set PIN D3 output
 	DDRD |= (0<<3);
@@ -109,58 +211,6 @@ void seven_segment_ports(void) {
 	DDRC = 0xFF; 
 }
 
-// For a given frequency (Hz), return the clock period
-uint16_t freq_to_clock_period(uint16_t freq) {
-	return (1000000UL / freq);
-}
-
-uint16_t duty_cycle_to_pulse_width(float dutycycle, uint16_t clockperiod) {
-	return (dutycycle * clockperiod) / 100;
-}
-
-void play_sound(uint16_t freq) {
-	// set PORT D pins 2, 4 and 5 to be outputs
-	DDRD |= (1<<4);
-	
-	float dutycycle = 50;	// % originally 2
-	uint16_t clockperiod = freq_to_clock_period(freq);
-	uint16_t pulsewidth = duty_cycle_to_pulse_width(dutycycle, clockperiod);
-	
-	// Set the maximum count value for timer/counter 1 to be one less than the clockperiod
-	OCR1A = clockperiod - 1;
-	
-	// Set the count compare value based on the pulse width. The value will be 1 less
-	// than the pulse width - unless the pulse width is 0.
-	if(pulsewidth == 0) {
-		OCR1B = 0;
-	} else {
-		OCR1B = pulsewidth - 1;
-	}
-	
-	// setup timer 1 
-	// Fast PWM, reset to 0 on OCR1A. Count at 1MHz (CLK/8)
-	// OC1B clears on  compare match, set on timer overflow (non-inverting)
-	TCCR1A = (1 << COM1B1) | (0 <<COM1B0) | (1 <<WGM11) | (1 << WGM10);
-	TCCR1B = (1 << WGM13) | (1 << WGM12) | (0 << CS12) | (1 << CS11) | (0 << CS10);
-	
-}
-
-void shoot_sound(void) {
-	
-	if(PIND & (1 << 3)) {
-		play_sound(3000);
-		start_shoot_time = get_current_time();
-	}
-}
-
-void hit_sound(void) {
-	
-	if(PIND & (1 << 3)) {
-		play_sound(1200);
-		start_shoot_time = get_current_time();
-	}
-}
-
 void splash_screen(void) {
 	// Clear terminal screen and output a message
 	clear_terminal();
@@ -168,30 +218,88 @@ void splash_screen(void) {
 	printf_P(PSTR("Asteroids"));
 	move_cursor(10,12);
 	printf_P(PSTR("CSSE2010/7201 project by Alex Patapan (s44792925)"));
+	highscores_show(HIGH_SCORE_X, HIGH_SCORE_Y, 0);
+#if MATRIX_BENCHMARK
+	matrix_benchmark();
+#endif
 	
 	// Output the scrolling message to the LED matrix
 	// and wait for a push button to be pushed.
 	ledmatrix_clear();
-	while(1) {
-		set_scrolling_display_text("ASTEROIDS S44792925", COLOUR_GREEN);
-		// Scroll the message until it has scrolled off the 
-		// display or a button is pushed
-		while(scroll_display()) {
-			_delay_ms(150);
-			if(button_pushed() != NO_BUTTON_PUSHED) {
-				return;
-			}
+	ledmatrix_wait_until_sent();
+	scroll_text_clear();
+	scroll_text_add_P(PSTR("ASTEROIDS S44792925"), COLOUR_GREEN);
+	
+	// Scroll the message (over and over) until a button is pushed
+	scheduler_init();
+	scheduler_add_task(scroll_message, SCROLL_PERIOD);
+	scheduler_add_task(splash_input, 0);
+}
+
+#if MATRIX_BENCHMARK
+// Output the time taken to send a full frame at each SPI clock divider,
+// unpaced and paced. A test pattern is sent so that any corruption 
+// at the faster speeds can be seen on the LED matrix.
+static void matrix_benchmark(void) {
+	static const PixelColour pattern[] PROGMEM = 
+			{ COLOUR_RED, COLOUR_GREEN, COLOUR_YELLOW, COLOUR_ORANGE };
+	uint8_t i = 0;
+	
+	for(uint8_t x=0; x<MATRIX_NUM_COLUMNS; x++) {
+		for(uint8_t y=0; y<MATRIX_NUM_ROWS; y++) {
+			ledmatrix_update_pixel(x, y, pgm_read_byte(&pattern[(x+y) & 3]));
 		}
 	}
+	move_cursor(10, MATRIX_BENCHMARK_ROW);
+	printf_P(PSTR("SPI divider  frame us  paced us (paced at %u bytes/ms)"),
+			ledmatrix_bytes_per_ms());
+	for(uint8_t divider=2; divider; divider <<= 1, i++) {
+		move_cursor(10, MATRIX_BENCHMARK_ROW + 1 + i);
+		printf_P(PSTR("%11u%10lu%10lu"), divider, 
+				(uint32_t)ledmatrix_frame_time(divider, 0) * 1000 / TIMER0_COUNTS_PER_MS,
+				(uint32_t)ledmatrix_frame_time(divider, 1) * 1000 / TIMER0_COUNTS_PER_MS);
+	}
+}
+#endif
+
+// Start the game when a button is pushed
+static void splash_input(void) {
+	if(button_pushed() != NO_BUTTON_PUSHED) {
+		request_state(STATE_PLAYING);
+	}
+}
+
+// Scroll the message on the LED matrix by one column - starting it 
+// again once it has scrolled off the display
+static void scroll_message(void) {
+	if(!scroll_display()) {
+		scroll_text_restart();
+	}
 }
 
 void new_game(void) {
 	
-	// Initialise the game and display
+	// Seed the random number generator. The time (to within 8 
+	// microseconds) at which the player started the game is 
+	// unpredictable so this gives a different game each time - unless
+	// we're replaying the last game, which needs its seed.
+	if(replay_requested) {
+		game_seed = replay_get_seed();
+	} else {
+		game_seed = prng_get_state() ^ (uint16_t)get_fine_time();
+	}
+	prng_seed(game_seed);
+	
+	// Initialise the game and clear the display (the game field is
+	// drawn by the next display update)
+	ledmatrix_clear();
 	initialise_game();
 	
-	// Clear the serial terminal
+	// Clear the serial terminal (and send all the telemetry fields 
+	// in the next frame)
 	clear_terminal();
+	terminal_status_init();
+	telemetry_init();
 	
 	// Initialise the score
 	init_score();
@@ -204,321 +312,273 @@ void new_game(void) {
 	(void)button_pushed();
 	clear_serial_input_buffer();
 	
-	basehit_sequence=1;
-	basehit_time = get_current_time();
-	
-	animation_x = 0;
-	animation_y = 0;
-	asteroid_animation_on=0;
-	asteroid_sequence = 1;
+	// No explosions yet
+	init_animations();
 }
 
-int pause = 0;
+// State used by the game tasks below
+static uint32_t joystick_repeat_time;
+static TaskId asteroid_task;
+
+// The game is made up of the following tasks which are run by the 
+// scheduler. Each checks whether the game is over before doing 
+// anything so that nothing happens once the last life is lost.
+static void handle_input(void);
+static void apply_input(uint16_t actions);
+static void move_asteroids(void);
+static void move_projectiles(void);
+static void read_joystick(void);
+static void animate(void);
+static void update_display(void);
+static void check_game_over(void);
+static void play_replay_inputs(void);
 
 void play_game(void) {
-	uint32_t current_time, last_move_time, last_asteroid_time, last_base_move;
-	int8_t button;
-	char serial_input, escape_sequence_char;
-	uint8_t characters_into_escape_sequence = 0;
-	
-	uint16_t value;
-	uint8_t axis = 0;
-	
-	startup = 1;
-	sequence = 1;
-	
-	// Get the current time and remember this as the last time the projectiles
-    // were moved.
-	current_time = get_current_time();
-	last_move_time = current_time;
-	last_asteroid_time = current_time;
-	last_base_move = current_time;
-	uint32_t startup_sequence = current_time;
-	
-	if ((PIND & (1 << 3))) {
-		play_sound(500);	
+	input_decoder_reset();
+	joystick_repeat_time = get_game_time();
+	sound_trigger(SOUND_STARTUP);
+	
+	// Set up the game tasks. Polled tasks (period 0) run on every pass
+	// of the scheduler - the display update must come after the others
+	// so it picks up all the changes made during the pass. The timed
+	// tasks are all scheduled from the same start time, and the 
+	// asteroid and projectile steps keep to their schedule (see 
+	// scheduler.h), so they interleave the same way in a replay.
+	scheduler_init();
+	asteroid_task = scheduler_add_task(move_asteroids, asteroid_period());
+	scheduler_add_task(move_projectiles, 500);
+	scheduler_add_task(read_joystick, 10);
+	scheduler_add_task(animate, ANIMATION_STEP_PERIOD);
+	scheduler_add_task(handle_input, 0);
+	scheduler_add_task(update_display, 0);
+	scheduler_add_task(check_game_over, 0);
+	
+	// Record the player's inputs (or play back the recorded ones) from
+	// now on
+	if(replay_requested) {
+		replay_playback_start();
 	} else {
-		startup = 0;
+		replay_record_start(game_seed);
 	}
 	
-	// We play the game until it's over
-	while(!is_game_over()) {
-		
-		if (!(PIND & (1 << 3))) {
-			DDRD &= (0<<4);
-		}
-		
-		
-		//make startup noises
-		if (startup) {		
-			
-			if((get_current_time()-(250-200*sin(sequence/1.1)) >= startup_sequence) && (PIND & (1 << 3))) {
-				
-				switch (sequence) {
-					case 1:
-						play_sound(800);
-						break;
-					case 2:
-						play_sound(1500);
-						break;
-					case 3:
-						play_sound(2000);
-						break;
-					case 4:
-						play_sound(2500);
-						break;
-				}
-				sequence++;
-				startup_sequence = get_current_time();
-			}
-			
-			if ((sequence == 5) || !(PIND & (1 << 3))) {
-				startup = 0;
-			}
-		}
-		
-		
-		
-		// Check for input - which could be a button push or serial input.
-		// Serial input may be part of an escape sequence, e.g. ESC [ D
-		// is a left cursor key press. At most one of the following three
-		// variables will be set to a value other than -1 if input is available.
-		// (We don't initalise button to -1 since button_pushed() will return -1
-		// if no button pushes are waiting to be returned.)
-		// Button pushes take priority over serial input. If there are both then
-		// we'll retrieve the serial input the next time through this loop
-		serial_input = -1;
-		escape_sequence_char = -1;
-		button = button_pushed();
-		
-		if(button == NO_BUTTON_PUSHED) {
-			// No push button was pushed, see if there is any serial input
-			if(serial_input_available()) {
-				// Serial data was available - read the data from standard input
-				serial_input = fgetc(stdin);
-				// Check if the character is part of an escape sequence
-				if(characters_into_escape_sequence == 0 && serial_input == ESCAPE_CHAR) {
-					// We've hit the first character in an escape sequence (escape)
-					characters_into_escape_sequence++;
-					serial_input = -1; // Don't further process this character
-				} else if(characters_into_escape_sequence == 1 && serial_input == '[') {
-					// We've hit the second character in an escape sequence
-					characters_into_escape_sequence++;
-					serial_input = -1; // Don't further process this character
-				} else if(characters_into_escape_sequence == 2) {
-					// Third (and last) character in the escape sequence
-					escape_sequence_char = serial_input;
-					serial_input = -1;  // Don't further process this character - we
-										// deal with it as part of the escape sequence
-					characters_into_escape_sequence = 0;
-				} else {
-					// Character was not part of an escape sequence (or we received
-					// an invalid second character in the sequence). We'll process 
-					// the data in the serial_input variable.
-					characters_into_escape_sequence = 0;
-				}
-			}
-		}
-		
-		// Process the input. 
-		if(button==3 || escape_sequence_char=='D' || serial_input=='L' || serial_input=='l') {
-			// Button 3 pressed OR left cursor key escape sequence completed OR
-			// letter L (lowercase or uppercase) pressed - attempt to move left
-			move_base(MOVE_LEFT);
-		} else if(button==2 || escape_sequence_char=='A' || serial_input==' ') {
-			// Button 2 pressed or up cursor key escape sequence completed OR
-			// space bar pressed - attempt to fire projectile
-			fire_projectile();
-		} else if(button==1 || escape_sequence_char=='B') {
-			// Button 1 pressed OR down cursor key escape sequence completed
-			// Ignore at present
-		} else if(button==0 || escape_sequence_char=='C' || serial_input=='R' || serial_input=='r') {
-			// Button 0 pressed OR right cursor key escape sequence completed OR
-			// letter R (lowercase or uppercase) pressed - attempt to move right
-			move_base(MOVE_RIGHT);
-		} else if(serial_input == 'p' || serial_input == 'P') {
-			// Unimplemented feature - pause/unpause the game until 'p' or 'P' is
-			// pressed again
-			serial_input = -1;
-			
-			
-			// stop timers
-			TCCR0B &= 0B11111000;
-			DDRD &= (0<<4);
-			
-			while (serial_input != 'p' && serial_input != 'P') {
-				if(serial_input_available()) {
-					// Serial data was available - read the data from standard input
-					serial_input = fgetc(stdin);
-				}
-			}
-			// start timers
-			TCCR0B = (1<<CS01)|(1<<CS00);
-			
-		}
-		// else - invalid input or we're part way through an escape sequence -
-		// do nothing
-		
-		current_time = get_current_time();
-		
-		// accelerate asteroids
-		if(!is_game_over() && (current_time >= last_asteroid_time + 500-get_score()*1.8)) {
-			// 500ms (0.5 second) has passed since the last time we moved
-			// the projectiles - move them - and keep track of the time we
-			// moved them
-			
-			advance_asteroids();
-			last_asteroid_time = current_time;
-		}
-				
-		if(!is_game_over() && current_time >= last_move_time + 500) {
-			// 500ms (0.5 second) has passed since the last time we moved
-			// the projectiles - move them - and keep track of the time we 
-			// moved them
-			
-			advance_projectiles();
-			last_move_time = current_time;
-		}
-		
-		// joystick controls
-		if(!is_game_over() && current_time >= last_base_move + 50) {
-			// Set the ADC mux to choose ADC0 if x_or_y is 0, ADC1 if x_or_y is 1
-			if(axis == 0) {
-				ADMUX &= ~1;
-				} else {
-				ADMUX |= 1;
-			}
-			// Start the ADC conversion
-			ADCSRA |= (1<<ADSC);
-			
-			while(ADCSRA & (1<<ADSC)) {
-				; /* Wait until conversion finished */
-			}
-			value = ADC; // read the value
-			if(axis == 0) {
-				// X value - move base
-				if (value > 700) {
-					move_base(MOVE_LEFT);
-					} else if (value < 300) {
-					move_base(MOVE_RIGHT);
-				}
-				} else {
-				//Y value - shoot
-				if (value > 700 || value < 300) {
-					fire_projectile();
-				}
-			}
-			// Next time through the loop, do the other direction
-			axis ^= 1;
-			last_base_move = current_time;	
-		}
-		
-		//handle basehit sound
-		if (!is_game_over() && base_hit_sound){
-			handle_basehit_sound();	
-		}
-		
-		//handle asteroid animation
-		if (!is_game_over() && asteroid_animation_on){
-			handle_asteroid_animation(animation_x, animation_y);
-		}
-		
-		
-		// stop shooting sound
-		if (!base_hit_sound && !startup && (start_shoot_time <= current_time-100)) {
-			DDRD &= (0<<4);
-		}
-	
+}
+
+// Pause the game. The game tasks stay in the scheduler but the timed
+// ones are frozen with game time - the display, seven segment display
+// and input keep going (and we still sleep between interrupts).
+void pause_game(void) {
+	pause_game_time();
+	sound_stop();
+}
+
+void resume_game(void) {
+	// Ignore any joystick movement made while paused
+	(void)joystick_events();
+	resume_game_time();
+}
+
+static void handle_input(void) {
+	uint16_t actions;
+	
+	// Check for input - which could be button pushes or serial input
+	// (see input_decoder.c). All the waiting input is dealt with, one
+	// push or key at a time in the order it arrived.
+	PROF_BEGIN(PROF_INPUT);
+	// When replaying, moves and shots come from the log instead
+	if(replay_is_playing() && game_state != STATE_PAUSED) {
+		play_replay_inputs();
 	}
-	
-	// We get here if the game is over.
-	
+	while((actions = input_decoder_next())) {
+		apply_input(actions);
+	}
+	PROF_END(PROF_INPUT);
 }
 
-void handle_basehit_sound(void) {
-	if((get_current_time()-(300-200*sin(basehit_sequence/0.8)) >= basehit_time)) {
-		if ((PIND & (1 << 3))) {
-			switch (basehit_sequence) {
-				case 1:
-				play_sound(500);
-				break;
-				case 2:
-				play_sound(350);
-				break;
-				case 3:
-				play_sound(200);
-				break;
-			}	
-		}
-		
-		basehit_sequence++;
-		basehit_time = get_current_time();
+// Act on a single push or key. A pause (or unpause) takes effect for
+// the input after it even though the state only changes at the end of
+// the scheduler pass, so it is checked against the requested state.
+static void apply_input(uint16_t actions) {
+	if(next_state == STATE_PAUSED) {
+		// Only unpausing (or a report or output mode change) does 
+		// anything while paused
+		actions &= ACTION_PAUSE|ACTION_REPORT|ACTION_TELEMETRY;
 	}
 	
-	if (basehit_sequence == 4) {
-		base_hit_sound = 0;
+	if(replay_is_playing()) {
+		actions &= ~(ACTION_LEFT|ACTION_RIGHT|ACTION_FIRE);
+	} else {
+		replay_record(REPLAY_KEYS, actions);
 	}
+	telemetry_input(actions);
 	
+	if(actions & ACTION_LEFT) {
+		move_base(MOVE_LEFT);
+	}
+	if(actions & ACTION_RIGHT) {
+		move_base(MOVE_RIGHT);
+	}
+	if(actions & ACTION_FIRE) {
+		fire_projectile();
+	}
+	if(actions & ACTION_PAUSE) {
+		// pause/unpause the game
+		if(next_state == STATE_PAUSED) {
+			request_state(STATE_PLAYING);
+		} else {
+			request_state(STATE_PAUSED);
+		}
+	}
+	if(actions & ACTION_TELEMETRY) {
+		toggle_output_mode();
+	}
+	if(actions & ACTION_REPORT) {
+		// Output the profiling results below the game status, 
+		// followed by the number of button pushes and serial 
+		// characters we've lost and the memory usage
+		profile_report(PROFILE_REPORT_ROW);
+		move_cursor(1, PROFILE_REPORT_ROW + PROFILE_REPORT_ROWS);
+		clear_to_end_of_line();
+		printf_P(PSTR("button overflows %u, serial overruns in %u out %u"), 
+				button_queue_overflows(), serial_input_overruns(),
+				serial_output_overruns());
+		memory_report(PROFILE_REPORT_ROW + PROFILE_REPORT_ROWS + 1);
+	}
 }
 
-void enable_basehit_sound(void) {
-	base_hit_sound = 1;
-	basehit_sequence = 1;
+static void move_asteroids(void) {
+	if(!is_game_over()) {
+		// accelerate asteroids - the period gets shorter as 
+		// the score increases
+		play_replay_inputs();
+		advance_asteroids();
+		scheduler_set_period(asteroid_task, asteroid_period());
+	}
 }
 
-void handle_asteroid_animation(int x, int y) {
-	
-	if (get_current_time()-10 >= asteroid_animation_time) {
-		switch (asteroid_sequence) {
-			case 1: 
-				explosion(x, y, COLOUR_ORANGE);
-			break;
-			case 2: 
-				explosion(x, y, COLOUR_LIGHT_ORANGE);
-			break;
-			case 3: 
-				explosion(x, y, COLOUR_ORANGE);
-			break;
-			case 4: 
-				explosion(x, y, COLOUR_BLACK);
-			asteroid_animation_on = 0;
-		}
-		asteroid_animation_time = get_current_time();
-		asteroid_sequence++;
-		redraw_all_projectiles();
-		redraw_all_asteroids();
-		
+static void move_projectiles(void) {
+	if(!is_game_over()) {
+		// 500ms (0.5 second) has passed since the last time we moved
+		// the projectiles - move them
+		play_replay_inputs();
+		advance_projectiles();
 	}
 }
 
-void explosion(int x, int y, PixelColour colour) {
-	ledmatrix_update_pixel(y,7-x, colour);
-	ledmatrix_update_pixel(y,7-x+1, colour);
-	ledmatrix_update_pixel(y,7-x-1, colour);
-	ledmatrix_update_pixel(y+1,7-x, colour);
-	if (y-1 >= 3) {
-		ledmatrix_update_pixel(y-1,7-x, colour);
+static void read_joystick(void) {
+	uint8_t pushed, held, actions;
+	uint32_t current_time;
+	
+	if(is_game_over()) {
+		return;
 	}
-		
 	
+	PROF_BEGIN(PROF_JOYSTICK);
+	// joystick controls. The joystick is sampled in the background 
+	// (see joystick.c). A new push acts straight away - if the
+	// joystick is held it repeats every JOYSTICK_REPEAT ms.
+	current_time = get_game_time();
+	pushed = joystick_events();
+	held = joystick_state();
+	if(!pushed && current_time - joystick_repeat_time >= JOYSTICK_REPEAT) {
+		pushed = held;
+	}
+	if(pushed) {
+		joystick_repeat_time = current_time;
+	}
+	actions = 0;
+	if(pushed & JOYSTICK_LEFT) {
+		actions = ACTION_LEFT;
+	} else if(pushed & JOYSTICK_RIGHT) {
+		actions = ACTION_RIGHT;
+	}
+	if(pushed & (JOYSTICK_UP|JOYSTICK_DOWN)) {
+		actions |= ACTION_FIRE;
+	}
 	
+	// When replaying, moves and shots come from the log instead (see
+	// play_replay_inputs())
+	if(replay_is_playing()) {
+		actions = 0;
+	} else {
+		replay_record(REPLAY_JOYSTICK, actions);
+	}
+	telemetry_input(actions);
 	
+	if(actions & ACTION_LEFT) {
+		move_base(MOVE_LEFT);
+	}
+	if(actions & ACTION_RIGHT) {
+		move_base(MOVE_RIGHT);
+	}
+	if(actions & ACTION_FIRE) {
+		fire_projectile();
+	}
+	PROF_END(PROF_JOYSTICK);
 }
 
-void enable_asteroid_animation(int x, int y) {
-	
-	if (!asteroid_animation_on) {
-		asteroid_animation_on = 1;
-		asteroid_sequence = 1;
-		asteroid_animation_time = get_current_time();
-		
-		animation_x = x;
-		animation_y = y;
+// Apply the replayed inputs which are due at the current game tick, in
+// the order they were recorded. This is called before each tick (so no
+// input is late) and whenever input is checked (so inputs aren't held
+// back until the next tick). If the log was full the replay ends at
+// the point it filled up and the player carries on from there.
+static void play_replay_inputs(void) {
+	uint8_t action;
+	uint8_t was_playing = replay_is_playing();
+	
+	while((action = replay_next_action())) {
+		telemetry_input(action);
+		if(action & ACTION_LEFT) {
+			move_base(MOVE_LEFT);
+		} else if(action & ACTION_RIGHT) {
+			move_base(MOVE_RIGHT);
+		} else {
+			fire_projectile();
+		}
+	}
+	if(was_playing && !replay_is_playing()) {
+		move_cursor(1, REPLAY_EXPORT_ROW);
+		clear_to_end_of_line();
+		printf_P(PSTR("Replay log was full - replay ended at tick %lu"), 
+				replay_truncated_tick());
+	}
+}
+
+static void animate(void) {
+	// move the explosions on
+	if (!is_game_over()){
+		PROF_BEGIN(PROF_ANIMATION);
+		animation_step();
+		PROF_END(PROF_ANIMATION);
+	}
+}
+
+static void update_display(void) {
+	// send this pass's display and terminal changes (with any 
+	// explosions drawn over the game)
+	PROF_BEGIN(PROF_MATRIX_FLUSH);
+	game_compose();
+	animation_compose();
+	ledmatrix_flush();
+	PROF_END(PROF_MATRIX_FLUSH);
+	PROF_BEGIN(PROF_TERMINAL_FLUSH);
+	terminal_status_flush();
+	telemetry_flush();
+	PROF_END(PROF_TERMINAL_FLUSH);
+}
+
+static void check_game_over(void) {
+	if(is_game_over()) {
+		request_state(STATE_GAME_OVER);
 	}
-	
 }
 
-void handle_game_over() {
+
+
+
+void handle_game_over(void) {
+	// Make sure the final frame of the game has been displayed
+	ledmatrix_wait_until_sent();
+	terminal_status_flush();
 	
 	move_cursor(10,13);
 	clear_to_end_of_line();
@@ -528,48 +588,100 @@ void handle_game_over() {
 	printf_P(PSTR("GAME OVER"));
 	move_cursor(10,15);
 	printf_P(PSTR("Press a button to start again"));
-	
-	base_hit_sound = 1;
-	basehit_sequence = 1;
-
-	int gameover_sequence = 0;
-	int arrangement = 0;
-	int reset = 0;
-	PixelColour colour[4] = {COLOUR_YELLOW, COLOUR_ORANGE}; 
-	PixelColour colour2[4] = {COLOUR_RED, COLOUR_GREEN}; 	
-	PixelColour pixelcolour;
-	
-	while(button_pushed() == NO_BUTTON_PUSHED) {
-		; // wait
-		
-		//handle basehit sound
-		if (base_hit_sound){
-			handle_basehit_sound();
-		} else {
-			DDRD &= (0<<4);
+	move_cursor(10,16);
+	printf_P(PSTR("(x to output the replay log, z to replay the game)"));
+	
+	// Add the score to the high score table (the table is saved in 
+	// the background) and show it with this game's entry marked.
+	// Replays don't count.
+	highscores_show(HIGH_SCORE_X, HIGH_SCORE_Y, 
+			replay_requested ? 0 : highscores_add(get_score()));
+	
+	sound_trigger(SOUND_GAME_OVER);
+	replay_stop();
+	replay_requested = 0;
+
+	// Show the game over pattern, then scroll the score across the 
+	// LED matrix, then start again - until a button is pushed
+	gameover_sequence = 0;
+	gameover_arrangement = 0;
+	scheduler_init();
+	scheduler_add_task(game_over_pattern, 100);
+	scheduler_add_task(game_over_ticker, SCROLL_PERIOD);
+	scheduler_add_task(game_over_input, 0);
+	input_decoder_reset();
+}
+
+// A button starts a new game, x outputs the replay log and z replays
+// the game that has just finished. The final telemetry is sent from 
+// here too.
+static void game_over_input(void) {
+	uint16_t actions;
+	
+	while((actions = input_decoder_next())) {
+		if(actions & ACTION_TELEMETRY) {
+			toggle_output_mode();
 		}
-		
-		_delay_ms(100);
-		// gameover animation
-		if (gameover_sequence<64) {
-			for (int i=0; i<8; i++) {  
-				//colours 1 row 
-				if (((16 <= gameover_sequence) && (gameover_sequence < 32)) || ((48 <= gameover_sequence) && (gameover_sequence < 64))) {
-					pixelcolour = COLOUR_BLACK;
-				} else if (gameover_sequence>=32) {
-					pixelcolour = colour[(i+arrangement)%2];
-				} else {
-					pixelcolour = colour2[(i+arrangement)%2];
-				}
-				ledmatrix_update_pixel(gameover_sequence%16, i, pixelcolour);
-			}
-			gameover_sequence++;
-			arrangement++;
-			
+		if(actions & ACTION_BUTTON) {
+			request_state(STATE_PLAYING);
+		}
+		if(actions & ACTION_EXPORT) {
+			move_cursor(1, REPLAY_EXPORT_ROW);
+			clear_to_end_of_line();
+			replay_export();
+		}
+		if(actions & ACTION_REPLAY) {
+			replay_requested = 1;
+			request_state(STATE_PLAYING);
+		}
+	}
+	telemetry_flush();
+}
+
+// Draw the next column of the game over pattern (on every panel, so a
+// taller field is covered too). Once all 64 columns (4 times across 
+// each panel) are drawn, the score ticker starts.
+static void game_over_pattern(void) {
+	PixelColour colour[2] = {COLOUR_YELLOW, COLOUR_ORANGE}; 
+	PixelColour colour2[2] = {COLOUR_RED, COLOUR_GREEN}; 	
+	MatrixColumn column;
+	
+	if (gameover_sequence == GAME_OVER_TICKER) {
+		return;
+	}
+	for (int i=0; i<MATRIX_NUM_ROWS; i++) {  
+		//colours 1 row 
+		if (((16 <= gameover_sequence) && (gameover_sequence < 32)) || ((48 <= gameover_sequence) && (gameover_sequence < 64))) {
+			column[i] = COLOUR_BLACK;
+		} else if (gameover_sequence>=32) {
+			column[i] = colour[(i+gameover_arrangement)%2];
 		} else {
-			gameover_sequence = 0;
-			reset = ~reset;
+			column[i] = colour2[(i+gameover_arrangement)%2];
 		}
 	}
-	
+	// The whole column goes out together (as a single command if 
+	// that's cheapest)
+	for (uint8_t panel = 0; panel < MATRIX_NUM_PANELS; panel++) {
+		ledmatrix_update_column(panel * MATRIX_PANEL_COLUMNS + 
+				gameover_sequence % MATRIX_PANEL_COLUMNS, column);
+	}
+	ledmatrix_flush();
+	gameover_sequence++;
+	gameover_arrangement++;
+	
+	if (gameover_sequence == 64) {
+		scroll_text_clear();
+		scroll_text_add_P(PSTR("SCORE "), COLOUR_GREEN);
+		scroll_text_add_number(get_score(), COLOUR_YELLOW);
+		gameover_sequence = GAME_OVER_TICKER;
+	}
+}
+
+// Scroll the score ticker (if it's showing). Once it has scrolled off
+// the display we go back to the game over pattern.
+static void game_over_ticker(void) {
+	if (gameover_sequence == GAME_OVER_TICKER && !scroll_display()) {
+		gameover_sequence = 0;
+	}
+
 }
@@ -0,0 +1,201 @@
+/*
+ * replay.c
+ *
+ * Author: Alex Patapan
+ *
+ * The log is a sequence of bytes. Each input is one byte:
+ *	bits 7-6	action (ENTRY_LEFT, ENTRY_RIGHT or ENTRY_FIRE)
+ *	bit 5		source (REPLAY_KEYS or REPLAY_JOYSTICK)
+ *	bits 4-0	game ticks since the previous input (0 to 31)
+ * If more than 31 ticks passed since the previous input, the input is 
+ * preceded by one or more delay bytes:
+ *	bits 7-6	ENTRY_DELAY
+ *	bits 5-0	n - add n * 32 ticks to the tick count (1 to 63)
+ * Inputs are played back in log order regardless of their source.
+ */
+
+#include <stdio.h>
+#include <avr/pgmspace.h>
+
+#include "replay.h"
+#include "input_decoder.h"
+#include "game.h"
+#include "memory.h"
+
+#define ENTRY_LEFT		0
+#define ENTRY_RIGHT		1
+#define ENTRY_FIRE		2
+#define ENTRY_DELAY		3
+
+#define ENTRY_TYPE(entry)		((entry) >> 6)
+#define ENTRY_SOURCE(entry)		(((entry) >> 5) & 1)
+#define ENTRY_TICKS(entry)		((entry) & 0x1F)
+#define ENTRY_DELAY_TICKS(entry)	(((uint16_t)(entry) & 0x3F) << 5)
+
+#define MAX_ENTRY_TICKS	31
+#define MAX_DELAY_UNITS	63
+
+// Action for each type of entry (in ENTRY_ order)
+static const uint8_t entry_actions[3] PROGMEM = {
+	ACTION_LEFT, ACTION_RIGHT, ACTION_FIRE };
+
+static uint8_t replay_log[REPLAY_LOG_SIZE];
+static uint16_t log_length;
+static uint16_t log_seed;
+static uint8_t log_full;
+
+// Game tick at which the log filled up (if log_full is set)
+static uint32_t full_tick;
+
+static uint8_t playing;
+
+// Game tick of the last input recorded or the next input to be played
+// back
+static uint32_t entry_tick;
+
+// Position in the log of the next input to be played back (after any
+// delay bytes before it)
+static uint16_t play_position;
+
+// Static data used by this module (see memory.h)
+MEMORY_USAGE(replay, sizeof(replay_log) + sizeof(log_length) + sizeof(log_seed) +
+		sizeof(log_full) + sizeof(full_tick) + sizeof(playing) + sizeof(entry_tick) + 
+		sizeof(play_position), sizeof(entry_actions));
+
+static void record_entry(uint8_t type, ReplaySource source);
+static void find_next_entry(void);
+
+void replay_record_start(uint16_t seed) {
+	log_length = 0;
+	log_seed = seed;
+	log_full = 0;
+	playing = 0;
+	entry_tick = 0;
+}
+
+void replay_record(ReplaySource source, uint8_t actions) {
+	if(playing) {
+		return;
+	}
+	if(actions & ACTION_LEFT) {
+		record_entry(ENTRY_LEFT, source);
+	}
+	if(actions & ACTION_RIGHT) {
+		record_entry(ENTRY_RIGHT, source);
+	}
+	if(actions & ACTION_FIRE) {
+		record_entry(ENTRY_FIRE, source);
+	}
+}
+
+void replay_playback_start(void) {
+	playing = 1;
+	entry_tick = 0;
+	play_position = 0;
+	find_next_entry();
+}
+
+uint8_t replay_is_playing(void) {
+	return playing;
+}
+
+uint8_t replay_next_action(void) {
+	uint8_t entry;
+	
+	if(!playing) {
+		return 0;
+	}
+	if(play_position >= log_length) {
+		// Nothing more is known about the game after the log filled
+		if(log_full && game_tick_count() >= full_tick) {
+			playing = 0;
+		}
+		return 0;
+	}
+	if(entry_tick > game_tick_count()) {
+		return 0;
+	}
+	entry = replay_log[play_position++];
+	find_next_entry();
+	return pgm_read_byte(&entry_actions[ENTRY_TYPE(entry)]);
+}
+
+uint8_t replay_is_truncated(void) {
+	return log_full;
+}
+
+uint32_t replay_truncated_tick(void) {
+	return full_tick;
+}
+
+void replay_stop(void) {
+	playing = 0;
+}
+
+uint16_t replay_get_seed(void) {
+	return log_seed;
+}
+
+void replay_export(void) {
+	printf_P(PSTR("replay seed %u, %u bytes"), log_seed, log_length);
+	if(log_full) {
+		printf_P(PSTR(" (full at tick %lu)"), full_tick);
+	}
+	putchar('\n');
+	for(uint16_t i = 0; i < log_length; i++) {
+		printf_P(PSTR("%02X"), replay_log[i]);
+		if((i & 0x1F) == 0x1F || i == log_length - 1) {
+			putchar('\n');
+		}
+	}
+}
+
+// Add an input to the log (with delay bytes before it if needed)
+static void record_entry(uint8_t type, ReplaySource source) {
+	uint32_t now = game_tick_count();
+	uint32_t ticks = now - entry_tick;
+	uint8_t units;
+	uint16_t bytes_needed = 1;
+	
+	// Make sure there's room for the whole input - we don't want to
+	// record part of one
+	if(ticks > MAX_ENTRY_TICKS) {
+		bytes_needed += ((ticks >> 5) + MAX_DELAY_UNITS - 1) / MAX_DELAY_UNITS;
+	}
+	if(log_full) {
+		return;
+	}
+	if(log_length + bytes_needed > REPLAY_LOG_SIZE) {
+		log_full = 1;
+		full_tick = now;
+		return;
+	}
+	
+	while(ticks > MAX_ENTRY_TICKS) {
+		units = ticks >> 5;
+		if(units > MAX_DELAY_UNITS) {
+			units = MAX_DELAY_UNITS;
+		}
+		replay_log[log_length++] = (ENTRY_DELAY << 6) | units;
+		ticks -= (uint16_t)units << 5;
+	}
+	replay_log[log_length++] = (type << 6) | (source << 5) | ticks;
+	entry_tick = now;
+}
+
+// Skip over any delay bytes at the play position (adding them to the
+// tick of the next input) and add on the next input's own ticks
+static void find_next_entry(void) {
+	uint8_t entry;
+	
+	while(play_position < log_length) {
+		entry = replay_log[play_position];
+		if(ENTRY_TYPE(entry) == ENTRY_DELAY) {
+			entry_tick += ENTRY_DELAY_TICKS(entry);
+			play_position++;
+		} else {
+			entry_tick += ENTRY_TICKS(entry);
+			return;
+		}
+	}
+}
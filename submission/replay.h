@@ -0,0 +1,74 @@
+/*
+ * replay.h
+ *
+ * Author: Alex Patapan
+ *
+ * Records the player's moves and shots during a game (along with the
+ * random number seed the game started with) so that the same game can
+ * be played again exactly - e.g. to compare the performance of the
+ * game before and after a change. Each input is tagged with the game 
+ * tick count (see game_tick_count()) at which it was taken, and played
+ * back at the same tick, so the replay doesn't depend on when the
+ * ticks ran. The log can also be output to the serial terminal.
+ */
+
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include <stdint.h>
+
+// Size (bytes) of the log. Most inputs take 1 byte.
+#define REPLAY_LOG_SIZE 256
+
+// Where an input came from
+typedef enum {
+	REPLAY_KEYS,		// push buttons or serial input
+	REPLAY_JOYSTICK
+} ReplaySource;
+
+// Start recording a new log for a game which has just started with
+// the given random number seed
+void replay_record_start(uint16_t seed);
+
+// Record the actions (ACTION_LEFT, ACTION_RIGHT and/or ACTION_FIRE -
+// see input_decoder.h) which were just taken. Other actions are 
+// ignored. If the log is full, nothing more is recorded.
+void replay_record(ReplaySource source, uint8_t actions);
+
+// Start playing back the log for a game which has just started (with 
+// the seed given by replay_get_seed())
+void replay_playback_start(void);
+
+// Return 1 if a log is being played back, 0 otherwise. (This stays
+// 1 after the end of the log until replay_stop() or a new recording.)
+uint8_t replay_is_playing(void);
+
+// Return the next action from the log (a single ACTION_LEFT, 
+// ACTION_RIGHT or ACTION_FIRE) if it is due at the current game tick,
+// or 0 if there isn't one. Call this until it returns 0 before every
+// game tick, so that each input is applied between the same ticks as
+// it was recorded, in the order it was recorded.
+// If the log filled up while it was being recorded, playback stops 
+// (replay_is_playing() returns 0) once the game reaches the tick at 
+// which it filled, as the log doesn't say what happened after that.
+uint8_t replay_next_action(void);
+
+// Returns 1 if the log filled up before the end of the game it was 
+// recorded from (so not all of the game can be replayed)
+uint8_t replay_is_truncated(void);
+
+// Returns the game tick at which the log filled up (only meaningful if
+// replay_is_truncated() returns 1)
+uint32_t replay_truncated_tick(void);
+
+// Stop playing back the log
+void replay_stop(void);
+
+// Return the random number seed of the game in the log
+uint16_t replay_get_seed(void);
+
+// Output the log to the terminal (starting at the cursor position) in
+// hexadecimal
+void replay_export(void);
+
+#endif /* REPLAY_H_ */
@@ -0,0 +1,167 @@
+/*
+ * scheduler.c
+ *
+ * Author: Alex Patapan
+ *
+ * Timed tasks are kept in the order array sorted by deadline (earliest
+ * first) so we only ever need to look at the front of the array to 
+ * know whether anything is due. When a task runs its deadline moves 
+ * later and it is moved back along the array to its new place.
+ */
+
+#include <avr/io.h>
+#include <avr/sleep.h>
+
+#include "scheduler.h"
+#include "timer0.h"
+#include "profiler.h"
+#include "memory.h"
+
+typedef struct {
+	TaskFunction function;
+	uint16_t period;
+	uint16_t overruns;
+	uint32_t deadline;
+} Task;
+
+static Task tasks[MAX_TASKS];
+static uint8_t num_tasks;
+
+// Indices into tasks[] of the timed tasks, in deadline order
+static uint8_t order[MAX_TASKS];
+static uint8_t num_timed_tasks;
+
+// Game time at which scheduler_init() was called - the first deadline 
+// of each task is one period after this
+static uint32_t start_time;
+
+// The task currently being run (or NO_TASK)
+static TaskId running_task = NO_TASK;
+
+// Has the given time reached the deadline? (This works even when the
+// clock tick count wraps around.)
+#define DEADLINE_REACHED(time, deadline) ((int32_t)((time) - (deadline)) >= 0)
+
+// Static data used by this module (see memory.h)
+MEMORY_USAGE(scheduler, sizeof(tasks) + sizeof(num_tasks) + sizeof(order) +
+		sizeof(num_timed_tasks) + sizeof(start_time) + sizeof(running_task), 0);
+
+static void sort_from(uint8_t position);
+
+void scheduler_init(void) {
+	num_tasks = 0;
+	num_timed_tasks = 0;
+	start_time = get_game_time();
+}
+
+TaskId scheduler_add_task(TaskFunction function, uint16_t period) {
+	Task* task;
+	if(num_tasks >= MAX_TASKS) {
+		return NO_TASK;
+	}
+	task = &tasks[num_tasks];
+	task->function = function;
+	task->period = period;
+	task->overruns = 0;
+	task->deadline = start_time + period;
+	if(period) {
+		// Add to the end of the timed tasks and move it into place
+		order[num_timed_tasks] = num_tasks;
+		num_timed_tasks++;
+		sort_from(num_timed_tasks - 1);
+	}
+	return num_tasks++;
+}
+
+void scheduler_set_period(TaskId task, uint16_t period) {
+	if(task < 0 || task >= num_tasks || tasks[task].period == 0) {
+		return;
+	}
+	if(period == 0) {
+		// Timed tasks always have a period of at least 1ms
+		period = 1;
+	}
+	if(task == running_task) {
+		// The deadline still holds the time this run was due - 
+		// scheduler_run() will add the new period to it when we return
+		tasks[task].period = period;
+		return;
+	}
+	tasks[task].deadline += (int16_t)(period - tasks[task].period);
+	tasks[task].period = period;
+	// The deadline may have moved earlier or later - re-sort 
+	// the whole (short) list
+	for(uint8_t i=1; i < num_timed_tasks; i++) {
+		sort_from(i);
+	}
+}
+
+void scheduler_run(void) {
+	Task* task;
+	uint32_t now = get_game_time();
+	uint8_t ran = 0;
+	
+	// Run timed tasks which are due, earliest deadline first (but no 
+	// more of them than there are timed tasks, so that catching up 
+	// can't hold up the polled tasks)
+	while(num_timed_tasks > 0 && ran < num_timed_tasks &&
+			DEADLINE_REACHED(now, tasks[order[0]].deadline)) {
+		task = &tasks[order[0]];
+		running_task = order[0];
+		task->function();
+		running_task = NO_TASK;
+		if(DEADLINE_REACHED(now, task->deadline + task->period)) {
+			// We've fallen a whole period behind - count it, but keep 
+			// to the schedule so the missed runs are caught up in order
+			task->overruns++;
+		}
+		task->deadline += task->period;
+		sort_from(0);
+		ran++;
+		now = get_game_time();
+	}
+	
+	// Run the polled tasks
+	for(uint8_t i=0; i < num_tasks; i++) {
+		if(tasks[i].period == 0) {
+			tasks[i].function();
+		}
+	}
+	
+	if(!ran) {
+		// Nothing was due - wait for the next interrupt. Idle mode keeps
+		// the clocks to the peripherals running, so timer0, the button 
+		// pin change, UART, SPI and ADC interrupts all wake us up.
+		set_sleep_mode(SLEEP_MODE_IDLE);
+		PROF_SLEEP_BEGIN();
+		sleep_mode();
+		PROF_SLEEP_END();
+	}
+}
+
+uint16_t scheduler_get_overruns(TaskId task) {
+	if(task < 0 || task >= num_tasks) {
+		return 0;
+	}
+	return tasks[task].overruns;
+}
+
+// Move the task at the given position in the order array along
+// the array until the deadlines are in order again.
+static void sort_from(uint8_t position) {
+	uint8_t task;
+	while(position > 0 && (int32_t)(tasks[order[position]].deadline - 
+			tasks[order[position-1]].deadline) < 0) {
+		task = order[position];
+		order[position] = order[position-1];
+		order[position-1] = task;
+		position--;
+	}
+	while(position + 1 < num_timed_tasks && (int32_t)(tasks[order[position]].deadline -
+			tasks[order[position+1]].deadline) > 0) {
+		task = order[position];
+		order[position] = order[position+1];
+		order[position+1] = task;
+		position++;
+	}
+}
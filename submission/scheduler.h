@@ -0,0 +1,71 @@
+/*
+ * scheduler.h
+ *
+ * Author: Alex Patapan
+ *
+ * A small cooperative scheduler. Tasks are registered with a period
+ * (in milliseconds) and a function to call. scheduler_run() calls each
+ * task whose deadline has been reached - deadlines advance by a fixed
+ * step each time a task runs, so tasks keep to a fixed timestep even
+ * if they are run a little late. If a task falls a whole period or
+ * more behind it is counted as an overrun but keeps to its schedule -
+ * it is run for every deadline it missed, catching up over the 
+ * following passes (each pass runs at most as many timed tasks as 
+ * there are, so the polled tasks still get to run). The order in which
+ * the timed tasks run therefore only depends on their periods, not on
+ * how long they take, which lets a game be replayed exactly.
+ *
+ * Tasks with a period of 0 are polled - they are run on every call
+ * to scheduler_run() (after any timed tasks that were due).
+ *
+ * When no timed task is due the CPU is put into idle sleep until the
+ * next interrupt (at the latest the next timer0 tick) rather than
+ * spinning.
+ *
+ * Deadlines are in game time (see timer0.h) so while game time is 
+ * paused the timed tasks are frozen - they keep their place and run
+ * on schedule once it is resumed. Polled tasks still run.
+ */
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <stdint.h>
+
+#define MAX_TASKS 8
+
+#define NO_TASK (-1)
+
+typedef void (*TaskFunction)(void);
+typedef int8_t TaskId;
+
+/* Remove all tasks. The tasks added after this are scheduled from the
+ * time this is called.
+ */
+void scheduler_init(void);
+
+/* Add a task which will be run every period milliseconds (or on every
+ * pass if the period is 0). The first run is one period after 
+ * scheduler_init() was called (so tasks added together keep in step).
+ * Returns the task ID, or NO_TASK if there are already MAX_TASKS tasks.
+ */
+TaskId scheduler_add_task(TaskFunction function, uint16_t period);
+
+/* Change the period of a timed task. The task's next deadline becomes
+ * one new period after its last deadline. This may be called from 
+ * the task itself. (Tasks can't be changed between timed and polled - 
+ * a period of 0 is treated as 1 for a timed task.)
+ */
+void scheduler_set_period(TaskId task, uint16_t period);
+
+/* Run any tasks that are due. If no timed task is due, sleep until the
+ * next interrupt before returning.
+ */
+void scheduler_run(void);
+
+/* Return the number of times the given task has overrun (fallen at 
+ * least a whole period behind).
+ */
+uint16_t scheduler_get_overruns(TaskId task);
+
+#endif /* SCHEDULER_H_ */
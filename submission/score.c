@@ -4,18 +4,48 @@
  * Written by Peter Sutton
  */
 
+#include <avr/pgmspace.h>
 #include "score.h"
+#include "intmath.h"
+#include "memory.h"
 
 uint32_t score;
 
+// Initially showing 0 (before init_score() is called)
+volatile uint8_t score_segments[2] = {63, 63};
+
+// Seven segment display segment values for 0 to 9
+static const uint8_t seven_segment[10] PROGMEM = {63,6,91,79,102,109,125,7,127,111};
+
+// Static data used by this module (see memory.h)
+MEMORY_USAGE(score, sizeof(score) + sizeof(score_segments), sizeof(seven_segment));
+
+static void update_score_segments(void);
+
 void init_score(void) {
 	score = 0;
+	update_score_segments();
 }
 
 void add_to_score(uint16_t value) {
 	score += value;
+	update_score_segments();
 }
 
 uint32_t get_score(void) {
 	return score;
 }
+
+static void update_score_segments(void) {
+	uint8_t tens, ones;
+	
+	// the SSD is capped at displaying a score of 99 at the max
+	tens = split_tens_ones((score > 99) ? 99 : (uint8_t)score, &ones);
+	
+	score_segments[0] = pgm_read_byte(&seven_segment[ones]);
+	if(tens > 0) {
+		score_segments[1] = pgm_read_byte(&seven_segment[tens]) | (1<<7);
+	} else {
+		score_segments[1] = score_segments[0];
+	}
+}
@@ -13,4 +13,13 @@ void init_score(void);
 void add_to_score(uint16_t value);
 uint32_t get_score(void);
 
-#endif /* SCORE_H_ */
\ No newline at end of file
+/* Seven segment display patterns for the score (capped at 99). 
+ * score_segments[0] is the right (ones) digit and score_segments[1] is
+ * the left (tens) digit, including the digit select bit (bit 7). If the
+ * score is less than 10 both entries show the right digit. These are 
+ * updated whenever the score changes so that the timer interrupt 
+ * handler only has to copy them to the port.
+ */
+extern volatile uint8_t score_segments[2];
+
+#endif /* SCORE_H_ */
@@ -11,6 +11,10 @@
  * letters are displayed as upper case). All other characters
  * display as a blank column.
  * 
+ * The message (which may be made up of parts in different colours) is
+ * turned into columns of dots once, when it is set, so scrolling just
+ * copies the next column to the display.
+ *
  * The program also demonstrates how data can be stored in the
  * program (flash) memory, without also taking up space in RAM.
  * If the arrays below were defined in the normal C way, they
@@ -25,6 +29,8 @@
 
 #include "scrolling_char_display.h"
 #include "ledmatrix.h"
+#include "intmath.h"
+#include "memory.h"
 #include <avr/pgmspace.h>
 
 /* FONT DEFINITION
@@ -104,36 +110,102 @@ static const uint8_t* const numbers[10] PROGMEM = {
 		cols_0, cols_1, cols_2, cols_3, cols_4, 
 		cols_5, cols_6, cols_7, cols_8, cols_9 };
 
-/* Keep track of the pixel colour to be used */
-static PixelColour colour = COLOUR_RED;
+/* The message is rendered once (by the scroll_text_add functions) into
+ * text_columns - one byte per column of the message in the same format
+ * as the font data (bits 7 to 1 are rows 7 to 1) but without the end of
+ * character bit. Each character is preceded by a blank column. Messages
+ * longer than MAX_TEXT_COLUMNS are cut short.
+ */
+#define MAX_TEXT_COLUMNS 128
+static uint8_t text_columns[MAX_TEXT_COLUMNS];
+static uint8_t text_length;
 
-/* Keep track of which column of data is next to be displayed. 
- * next_col_ptr points to that column, or is 0 if there is
- * no next column.
+/* The colour of the message is given by a list of runs - each run
+ * gives the colour of the columns from its start column up to the 
+ * start of the next run.
  */
-static volatile const uint8_t* next_col_ptr = 0;
+#define MAX_COLOUR_RUNS 4
+typedef struct {
+	uint8_t start;
+	PixelColour colour;
+} ColourRun;
+static ColourRun colour_runs[MAX_COLOUR_RUNS];
+static uint8_t num_colour_runs;
 
-/* String to be displayed. 
- * next_char_to_display will be used to point to the next
- * character from this string to be displayed.
+/* Width of each digit added by scroll_text_add_number() - the width of
+ * the widest digit in the font. Narrower digits are padded with blank
+ * columns so that numbers don't jiggle as they change.
  */
-static char* display_string;
+#define DIGIT_WIDTH 4
 
-static volatile char* next_char_to_display = 0;
+/* Scrolling state - the next column of the message to be displayed,
+ * the colour run it is in and the number of blank columns still to be
+ * shifted in (to scroll the end of the message off the display).
+ */
+static uint8_t next_column;
+static uint8_t current_run;
+static uint8_t blank_columns_left;
 
-/*
- * Set the message to be displayed - we just copy the 
- * pointer not the string it points to, so it is important
- * that the original string not change after this function
- * is called while the string is still being displayed.
- * We reset the pointers to ensure the next column to be displayed
- * comes from the first character of this string.
+/* Static data used by this module (see memory.h) - the font is in 
+ * program memory
  */
+MEMORY_USAGE(scrolling, sizeof(text_columns) + sizeof(text_length) + 
+		sizeof(colour_runs) + sizeof(num_colour_runs) + sizeof(next_column) +
+		sizeof(current_run) + sizeof(blank_columns_left),
+		sizeof(cols_A) + sizeof(cols_B) + sizeof(cols_C) + sizeof(cols_D) +
+		sizeof(cols_E) + sizeof(cols_F) + sizeof(cols_G) + sizeof(cols_H) +
+		sizeof(cols_I) + sizeof(cols_J) + sizeof(cols_K) + sizeof(cols_L) +
+		sizeof(cols_M) + sizeof(cols_N) + sizeof(cols_O) + sizeof(cols_P) +
+		sizeof(cols_Q) + sizeof(cols_R) + sizeof(cols_S) + sizeof(cols_T) +
+		sizeof(cols_U) + sizeof(cols_V) + sizeof(cols_W) + sizeof(cols_X) +
+		sizeof(cols_Y) + sizeof(cols_Z) + sizeof(cols_0) + sizeof(cols_1) +
+		sizeof(cols_2) + sizeof(cols_3) + sizeof(cols_4) + sizeof(cols_5) +
+		sizeof(cols_6) + sizeof(cols_7) + sizeof(cols_8) + sizeof(cols_9) +
+		sizeof(letters) + sizeof(numbers));
+
+static void add_column(uint8_t column_data);
+static void add_char(char c, uint8_t width);
+static void start_colour(PixelColour colour);
+
+void scroll_text_clear(void) {
+	text_length = 0;
+	num_colour_runs = 0;
+	scroll_text_restart();
+}
+
+void scroll_text_add(const char* string, PixelColour colour) {
+	start_colour(colour);
+	while(*string) {
+		add_char(*string++, 0);
+	}
+}
+
+void scroll_text_add_P(const char* string, PixelColour colour) {
+	char c;
+	start_colour(colour);
+	while((c = pgm_read_byte(string++))) {
+		add_char(c, 0);
+	}
+}
+
+void scroll_text_add_number(uint32_t value, PixelColour colour) {
+	char digits[U32_MAX_DIGITS + 1];
+	format_u32(value, digits);
+	start_colour(colour);
+	for(char* digit = digits; *digit; digit++) {
+		add_char(*digit, DIGIT_WIDTH);
+	}
+}
+
+void scroll_text_restart(void) {
+	next_column = 0;
+	current_run = 0;
+	blank_columns_left = MATRIX_NUM_COLUMNS;
+}
+
 void set_scrolling_display_text(char* string_to_display, PixelColour c) {
-	colour = c;
-	display_string = string_to_display;
-	next_col_ptr = 0;
-	next_char_to_display = 0;
+	scroll_text_clear();
+	scroll_text_add(string_to_display, c);
 }
 
 /*
@@ -142,106 +214,92 @@ void set_scrolling_display_text(char* string_to_display, PixelColour c) {
  * Returns 1 if still scrolling display.
  */
 uint8_t scroll_display(void) {
-	static uint8_t shift_countdown = 0;
 	uint8_t i;
 	uint8_t col_data;
-	char next_char;
-	uint8_t finished = 0;
-
-	/* Data to be displayed in the next column - by 
-	 * default we show a blank column. Bit 7 of this
-	 * column data corresponds to row 7 of the display
-	 * etc.
-	 */
-	col_data = 0;
-
-	if(next_col_ptr) {
-		/* We're currently outputting a character and next_col_ptr
-		 * points to the display data for the next column. We
-		 * extract that data from program memory.
-		 */
-		col_data = pgm_read_byte(next_col_ptr);
-
-		if(col_data & 1) {
-			/* Least significant bit is set - this is the last
-			 * column of this character
-			 */
-			next_col_ptr = 0;
-		} else {
-			/* This is not the last column of this character - make
-			 * the pointer point to the data for the next column.
-			 */
-			next_col_ptr++;
-		}
-	} else if(next_char_to_display) {
-		/* We're not currently outputting a character, but we
-		 * do have more characters to display. We will output
-		 * a blank column this time (col_data value remains 0)
-		 * but we will set up our pointer (next_col_ptr) so that
-		 * it points to the data for the first column of dots for
-		 * the next character. We first get the next character to be 
-		 * displayed and advance our next character pointer 
-		 * (next_char_to_display) so that it points to the character 
-		 * after.
+	PixelColour colour = COLOUR_BLACK;
+	MatrixColumn column_colour_data;
+	
+	if(next_column < text_length) {
+		/* Next column of the message - find its colour (moving on
+		 * to the next colour run if we've reached it)
 		 */
-		next_char = *(next_char_to_display++);
-		if(next_char == 0) {
-			/* We reached the null character at the end of the string.
-			 * There is no next character, reset our pointer to 
-			 * the next character and set our countdown until the 
-			 * message disappears from the display.
-			 */
-			next_char_to_display = 0;
-			shift_countdown = 16;
-		} else if (next_char >= 'a' && next_char <= 'z') {
-			/* Character is a lower case letter - the next column to 
-			 * be displayed will be the first column of the letter
-			 * data for that letter
-			 */
-			next_col_ptr = (const uint8_t*)pgm_read_word(&letters[next_char - 'a']);
-		} else if (next_char >= 'A' && next_char <= 'Z') {
-			/* Upper case character */
-			next_col_ptr = (const uint8_t*)pgm_read_word(&letters[next_char - 'A']);
-		} else if (next_char >= '0' && next_char <= '9') {
-			/* Digit */
-			next_col_ptr = (const uint8_t*)pgm_read_word(&numbers[next_char - '0']);
+		col_data = text_columns[next_column];
+		while(current_run + 1 < num_colour_runs && 
+				next_column >= colour_runs[current_run + 1].start) {
+			current_run++;
 		}
+		colour = colour_runs[current_run].colour;
+		next_column++;
+	} else if(blank_columns_left) {
+		/* Scrolling the end of the message off the display */
+		col_data = 0;
+		blank_columns_left--;
 	} else {
-		/* We're not outputting a column of dots and there is 
-		 * no next character. Move on to the string that we
-		 * have stored (if any).
-		 */
-		if(!display_string) {
-			/* May be finished - flag this and adjust below if we're still
-			 * showing pixels
-			 */
-			finished = 1;
-		}
-		next_char_to_display = display_string;
-		display_string = 0;
+		/* Finished */
+		return 0;
 	}
 	
 	/* Shift the current display one pixel to the left and insert the 
 	 * new column data at column 15.
-	 * Adjust our "finished" variable if we've finished scrolling the
-	 * message off the display
 	 */
 	ledmatrix_shift_display_left();
-	MatrixColumn column_colour_data;
 	for(i=7; i>=1; i--) {
-		// If the relevant font bit is set, we make this a red pixel, otherwise blank
-		if(col_data & 0x80) {
-			column_colour_data[i] = colour;
-		} else {
-			column_colour_data[i] = 0;
-		}
+		// If the relevant font bit is set, we colour this pixel, otherwise blank
+		column_colour_data[i] = (col_data & 0x80) ? colour : COLOUR_BLACK;
 		col_data <<= 1;
 	}
-	column_colour_data[0] = 0;
-	ledmatrix_update_column(15, column_colour_data);
-	if(shift_countdown > 0) {
-		shift_countdown--;
+	column_colour_data[0] = COLOUR_BLACK;
+	ledmatrix_update_column(MATRIX_NUM_COLUMNS - 1, column_colour_data);
+	ledmatrix_flush();
+	return 1;
+}
+
+/* Add a column to the end of the message (if there is room) */
+static void add_column(uint8_t column_data) {
+	if(text_length < MAX_TEXT_COLUMNS) {
+		text_columns[text_length++] = column_data & 0xFE;
+	}
+}
+
+/* Add a character (preceded by a blank column) to the end of the
+ * message, padded with blank columns to at least width columns. 
+ * Lower case letters are displayed as upper case. All characters 
+ * other than letters and digits display as just the blank column.
+ */
+static void add_char(char c, uint8_t width) {
+	const uint8_t* col_ptr = 0;
+	uint8_t col_data;
+	
+	add_column(0);
+	if (c >= 'a' && c <= 'z') {
+		col_ptr = (const uint8_t*)pgm_read_word(&letters[c - 'a']);
+	} else if (c >= 'A' && c <= 'Z') {
+		col_ptr = (const uint8_t*)pgm_read_word(&letters[c - 'A']);
+	} else if (c >= '0' && c <= '9') {
+		col_ptr = (const uint8_t*)pgm_read_word(&numbers[c - '0']);
+	}
+	if(col_ptr) {
+		/* Copy columns until the one with the end of character bit */
+		do {
+			col_data = pgm_read_byte(col_ptr++);
+			add_column(col_data);
+			if(width) {
+				width--;
+			}
+		} while(!(col_data & 1));
+	}
+	while(width--) {
+		add_column(0);
+	}
+}
+
+/* Start a new colour run at the end of the message (unless we've run 
+ * out of runs, in which case the last run continues)
+ */
+static void start_colour(PixelColour colour) {
+	if(num_colour_runs < MAX_COLOUR_RUNS) {
+		colour_runs[num_colour_runs].start = text_length;
+		colour_runs[num_colour_runs].colour = colour;
+		num_colour_runs++;
 	}
-	finished = finished && (shift_countdown == 0);
-	return !finished;
 }
@@ -10,23 +10,40 @@
 #include <stdint.h>
 #include "pixel_colour.h"
 
+/* Time (ms) between scroll_display() calls for a comfortable 
+ * scrolling speed
+ */
+#define SCROLL_PERIOD 150
+
+/* Set the message to be displayed. A message is built by clearing it
+ * and then adding text and numbers, each in its own colour (up to 4 
+ * colours). The text is copied (as columns of dots) so the strings 
+ * may change after these functions return. Setting a message starts it
+ * scrolling from the beginning and will overwrite/interfere with any
+ * currently scrolling message. To avoid this, wait until the 
+ * scroll_display() function below has returned 0 to indicate the 
+ * message scrolling is complete. Numbers are added with fixed width
+ * digits. scroll_text_add_P() takes a string in program memory.
+ */
+void scroll_text_clear(void);
+void scroll_text_add(const char* string, PixelColour colour);
+void scroll_text_add_P(const char* string, PixelColour colour);
+void scroll_text_add_number(uint32_t value, PixelColour colour);
+
+/* Start scrolling the current message again from the beginning */
+void scroll_text_restart(void);
+
 /* Sets the text to be displayed and the colour it will be
- * scrolled with. The message will start displaying immediately
- * so will overwrite/interfere with any currently scrolling
- * message. To avoid this, wait until the scroll_display()
- * function below has returned 0 to indicate the message scrolling
- * is complete. Note that this string is not 
- * copied, so it is important that this string not change
- * after this function is called while the string is still
- * being displayed.
+ * scrolled with (i.e. clears the message and adds the string).
  */
 void set_scrolling_display_text(char* string, PixelColour colour);
 
 /* Scroll the display. Should be called whenever the display
- * is to be scrolled one pixel to the left. It is recommended that
- * this function NOT be called from an interrupt service routine as
- * it will wait for SPI communication to be finished before returning. 
- * This could take over 1ms.
+ * is to be scrolled one pixel to the left (e.g. from a scheduler task
+ * every SCROLL_PERIOD ms). This function should
+ * NOT be called from an interrupt service routine as it may wait
+ * for space in the SPI transmit queue. (The SPI commands are queued
+ * so the function will normally return before they have been sent.)
  * Returns 1 while a message is still scrolling, 0 when done.
  */
 uint8_t scroll_display(void);
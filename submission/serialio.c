@@ -16,7 +16,10 @@
  * until a character is available. If interrupts are disabled when 
  * input is sought, then this will block forever.
  * The function input_available() can be used to test whether there is
- * input available to read from stdin.
+ * input available to read from stdin. serial_read() and serial_write()
+ * read and write blocks of characters directly (without going through
+ * stdio) and never block. In binary mode text output is discarded and
+ * serial_write_frame() is used to send framed binary data instead.
  *
  */
 
@@ -26,40 +29,68 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
+#include "serialio.h"
+#include "memory.h"
+
 /* System clock rate in Hz. (L at the end indicates this is a long constant) */
 #define SYSCLK 8000000L
 
 /* Global variables */
-/* Circular buffer to hold outgoing characters. The insert_pos variable
- * keeps track of the position (0 to OUTPUT_BUFFER_SIZE-1) that the next
- * outgoing character should be written to. bytes_in_buffer keeps
- * count of the number of characters currently stored in the buffer 
- * (ranging from 0 to OUTPUT_BUFFER_SIZE). This number of bytes immediately
- * prior to the current insert_pos are the bytes waiting to be output.
- * If the insert_pos reaches the end of the buffer it will wrap around
- * to the beginning (assuming those bytes have been output).
- * NOTE - OUTPUT_BUFFER_SIZE can not be larger than 255 without changing
- * the type of the variables below (currently defined as 8 bit unsigned ints).
+/* Circular buffers to hold outgoing and incoming characters. Characters
+ * are added at the head position and removed from the tail position. 
+ * For the output buffer the head is only changed by the put functions
+ * and the tail only by the UDR empty interrupt handler - for the input 
+ * buffer the head is only changed by the receive complete interrupt
+ * handler and the tail only by the get functions. Each position is a 
+ * single byte (so is read and written in one go) and so neither side
+ * needs to turn interrupts off. The positions count up continuously 
+ * (wrapping around from 255 to 0) and are masked to index the buffer - 
+ * the number of characters in a buffer is (head - tail). Since that 
+ * is a byte, a buffer holds one character less than its size (so a 
+ * full 256 byte buffer can't look empty).
+ * NOTE - the buffer sizes must be powers of two no larger than 256.
  */
-#define OUTPUT_BUFFER_SIZE 255
-volatile char out_buffer[OUTPUT_BUFFER_SIZE];
-volatile uint8_t out_insert_pos;
-volatile uint8_t bytes_in_out_buffer;
+#define OUTPUT_BUFFER_SIZE 256
+#define OUTPUT_BUFFER_MASK (OUTPUT_BUFFER_SIZE - 1)
+#define OUTPUT_BUFFER_SPACE (OUTPUT_BUFFER_SIZE - 1)
+static volatile char out_buffer[OUTPUT_BUFFER_SIZE];
+static volatile uint8_t out_head;
+static volatile uint8_t out_tail;
+
+#define INPUT_BUFFER_SIZE 32
+#define INPUT_BUFFER_MASK (INPUT_BUFFER_SIZE - 1)
+#define INPUT_BUFFER_SPACE (INPUT_BUFFER_SIZE - 1)
+static volatile char input_buffer[INPUT_BUFFER_SIZE];
+static volatile uint8_t input_head;
+static volatile uint8_t input_tail;
 
-/* Circular buffer to hold incoming characters. Works on same principle
- * as output buffer
+/* Counts of characters lost. Input overruns are characters received 
+ * when the input buffer was full (or which the UART itself lost because
+ * we didn't read them in time). Output overruns are characters we 
+ * didn't output because the output buffer was full (and we couldn't 
+ * wait).
  */
-#define INPUT_BUFFER_SIZE 16
-volatile char input_buffer[INPUT_BUFFER_SIZE];
-volatile uint8_t input_insert_pos;
-volatile uint8_t bytes_in_input_buffer;
-volatile uint8_t input_overrun;
+static volatile uint16_t input_overruns;
+static volatile uint16_t output_overruns;
 
 /* Variable to keep track of whether incoming characters are to be echoed
  * back or not.
  */
 static int8_t do_echo;
 
+/* Non-zero if we're in binary mode (text output is discarded) */
+static int8_t binary_mode;
+
+/* Static data used by this module (see memory.h) */
+MEMORY_USAGE(serialio, sizeof(out_buffer) + sizeof(out_head) + sizeof(out_tail) +
+		sizeof(input_buffer) + sizeof(input_head) + sizeof(input_tail) +
+		sizeof(input_overruns) + sizeof(output_overruns) + sizeof(do_echo) +
+		sizeof(binary_mode) + sizeof(FILE), 0);
+
+#if SERIAL_FRAME_MAX_PAYLOAD + 4 > OUTPUT_BUFFER_SPACE
+#error "Frames must fit in the output buffer"
+#endif
+
 /* Function prototypes 
  */
 void init_serial_stdio(long baudrate, int8_t echo);
@@ -77,11 +108,11 @@ void init_serial_stdio(long baudrate, int8_t echo) {
 	/*
 	 * Initialise our buffers
 	*/
-	out_insert_pos = 0;
-	bytes_in_out_buffer = 0;
-	input_insert_pos = 0;
-	bytes_in_input_buffer = 0;
-	input_overrun = 0;
+	out_head = out_tail = 0;
+	input_head = input_tail = 0;
+	input_overruns = 0;
+	output_overruns = 0;
+	binary_mode = 0;
 	
 	/*
 	 * Record whether we're going to echo characters or not
@@ -119,23 +150,124 @@ void init_serial_stdio(long baudrate, int8_t echo) {
 }
 
 int8_t serial_input_available(void) {
-	return (bytes_in_input_buffer != 0);
+	return (input_head != input_tail);
 }
 
 void clear_serial_input_buffer(void) {
 	/* Just adjust our buffer data so it looks empty */
-	input_insert_pos = 0;
-	bytes_in_input_buffer = 0;
+	input_tail = input_head;
+}
+
+uint8_t serial_read(char* buffer, uint8_t length) {
+	uint8_t tail = input_tail;
+	uint8_t available = input_head - tail;
+	uint8_t i;
+	
+	if(length > available) {
+		length = available;
+	}
+	for(i = 0; i < length; i++) {
+		buffer[i] = input_buffer[tail++ & INPUT_BUFFER_MASK];
+	}
+	/* Only free up the space once we've copied the characters out */
+	input_tail = tail;
+	
+	if(do_echo) {
+		for(i = 0; i < length; i++) {
+			uart_put_char(buffer[i], 0);
+		}
+	}
+	return length;
+}
+
+uint8_t serial_write(const char* buffer, uint8_t length) {
+	uint8_t head = out_head;
+	uint8_t space = OUTPUT_BUFFER_SPACE - (uint8_t)(head - out_tail);
+	uint8_t i;
+	
+	if(binary_mode) {
+		return length;
+	}
+	if(length > space) {
+		output_overruns += length - space;
+		length = space;
+	}
+	for(i = 0; i < length; i++) {
+		out_buffer[head++ & OUTPUT_BUFFER_MASK] = buffer[i];
+	}
+	/* Only make the characters visible to the interrupt handler once
+	 * they're in the buffer, then make sure the UDR Empty interrupt is
+	 * enabled so that it will fire and deal with them.
+	 */
+	out_head = head;
+	if(length) {
+		UCSR0B |= (1 << UDRIE0);
+	}
+	return length;
+}
+
+uint16_t serial_input_overruns(void) {
+	uint16_t overruns;
+	uint8_t interrupts_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	overruns = input_overruns;
+	if(interrupts_enabled) {
+		sei();
+	}
+	return overruns;
+}
+
+uint16_t serial_output_overruns(void) {
+	return output_overruns;
+}
+
+void serial_set_binary(int8_t binary) {
+	binary_mode = binary;
+}
+
+int8_t serial_is_binary(void) {
+	return binary_mode;
+}
+
+int8_t serial_write_frame(uint8_t type, const uint8_t* payload, uint8_t length) {
+	uint8_t head = out_head;
+	uint8_t space = OUTPUT_BUFFER_SPACE - (uint8_t)(head - out_tail);
+	uint8_t checksum;
+	uint8_t i;
+	
+	if(length > SERIAL_FRAME_MAX_PAYLOAD || space < length + 4) {
+		return 0;
+	}
+	out_buffer[head++ & OUTPUT_BUFFER_MASK] = SERIAL_FRAME_SYNC;
+	out_buffer[head++ & OUTPUT_BUFFER_MASK] = type;
+	out_buffer[head++ & OUTPUT_BUFFER_MASK] = length;
+	checksum = type + length;
+	for(i = 0; i < length; i++) {
+		out_buffer[head++ & OUTPUT_BUFFER_MASK] = payload[i];
+		checksum += payload[i];
+	}
+	out_buffer[head++ & OUTPUT_BUFFER_MASK] = -checksum;
+	
+	/* As in serial_write(), only make the frame visible once it's all
+	 * in the buffer
+	 */
+	out_head = head;
+	UCSR0B |= (1 << UDRIE0);
+	return 1;
 }
 
 static int uart_put_char(char c, FILE* stream) {
 	uint8_t interrupts_enabled;
+	uint8_t head;
 	
 	/* Add the character to the buffer for transmission (if there 
 	 * is space to do so). If not we wait until the buffer has space.
 	 * If the character is \n, we output \r (carriage return)
 	 * also.
 	*/
+	if(binary_mode) {
+		return 0;
+	}
 	if(c == '\n') {
 		uart_put_char('\r', stream);
 	}
@@ -144,72 +276,41 @@ static int uart_put_char(char c, FILE* stream) {
 	 * abort - we don't output the character since the buffer will
 	 * never be emptied if interrupts are disabled. If the buffer is full
 	 * and interrupts are enabled then we loop until the buffer has 
-	 * enough space. The bytes_in_buffer variable will get modified by the
+	 * enough space. The tail position will get modified by the
 	 * ISR which extracts bytes from the buffer.
 	*/
 	interrupts_enabled = bit_is_set(SREG, SREG_I);
-	while(bytes_in_out_buffer >= OUTPUT_BUFFER_SIZE) {
+	head = out_head;
+	while((uint8_t)(head - out_tail) >= OUTPUT_BUFFER_SPACE) {
 		if(!interrupts_enabled) {
+			output_overruns++;
 			return 1;
 		}		
 		/* else do nothing */
 	}
 	
-	/* Add the character to the buffer for transmission if there
-	 * is space to do so. We advance the insert_pos to the next
-	 * character position. If this is beyond the end of the buffer
-	 * we wrap around back to the beginning of the buffer 
-	 * NOTE: we disable interrupts before modifying the buffer. This
-	 * prevents the ISR from modifying the buffer at the same time.
-	 * We reenable them if they were enabled when we entered the
-	 * function.
+	/* Add the character to the buffer for transmission and advance
+	 * the head position, then make sure the UDR Empty interrupt is
+	 * enabled so that it will fire and deal with the character.
 	*/	
-	cli();
-	out_buffer[out_insert_pos++] = c;
-	bytes_in_out_buffer++;
-	if(out_insert_pos == OUTPUT_BUFFER_SIZE) {
-		/* Wrap around buffer pointer if necessary */
-		out_insert_pos = 0;
-	}
-	/* Reenable interrupts (UDR Empty interrupt may have been
-	 * disabled) - we ensure it is now enabled so that it will
-	 * fire and deal with the next character in the buffer. */
+	out_buffer[head & OUTPUT_BUFFER_MASK] = c;
+	out_head = head + 1;
 	UCSR0B |= (1 << UDRIE0);
-	if(interrupts_enabled) {
-		sei();
-	}
 	return 0;
 }
 
 int uart_get_char(FILE* stream) {
+	char c;
+	
 	/* Wait until we've received a character */
-	while(bytes_in_input_buffer == 0) {
+	while(!serial_input_available()) {
 		/* do nothing */
 	}
 	
-	/*
-	 * Turn interrupts off and remove a character from the input
-	 * buffer. We reenable interrupts if they were on.
-	 * The pending character is the one which is byte_in_input_buffer
-	 * characters before the insert position (taking into account
-	 * that we may need to wrap around).
+	/* Remove the character from the input buffer (echoing it if 
+	 * required)
 	 */
-	uint8_t interrupts_enabled = bit_is_set(SREG, SREG_I);
-	cli();
-	char c;
-	if(input_insert_pos - bytes_in_input_buffer < 0) {
-		/* Need to wrap around */
-		c = input_buffer[input_insert_pos - bytes_in_input_buffer
-				+ INPUT_BUFFER_SIZE];
-	} else {
-		c = input_buffer[input_insert_pos - bytes_in_input_buffer];
-	}
-	
-	/* Decrement our count of bytes in the input buffer */
-	bytes_in_input_buffer--;
-	if(interrupts_enabled) {
-		sei();
-	}	
+	serial_read(&c, 1);
 	return c;
 }
 
@@ -220,28 +321,13 @@ int uart_get_char(FILE* stream) {
 ISR(USART0_UDRE_vect) 
 {
 	/* Check if we have data in our buffer */
-	if(bytes_in_out_buffer > 0) {
+	uint8_t tail = out_tail;
+	if(out_head != tail) {
 		/* Yes we do - remove the pending byte and output it
-		 * via the UART. The pending byte (character) is the
-		 * one which is "bytes_in_buffer" characters before the 
-		 * insert_pos (taking into account that we may 
-		 * need to wrap around to the end of the buffer).
+		 * via the UART. 
 		 */
-		char c;
-		if(out_insert_pos - bytes_in_out_buffer < 0) {
-			/* Need to wrap around */
-			c = out_buffer[out_insert_pos - bytes_in_out_buffer
-				+ OUTPUT_BUFFER_SIZE];
-		} else {
-			c = out_buffer[out_insert_pos - bytes_in_out_buffer];
-		}
-		/* Decrement our count of the number of bytes in the 
-		 * buffer 
-		 */
-		bytes_in_out_buffer--;
-		
-		/* Output the character via the UART */
-		UDR0 = c;
+		UDR0 = out_buffer[tail & OUTPUT_BUFFER_MASK];
+		out_tail = tail + 1;
 	} else {
 		/* No data in the buffer. We disable the UART Data
 		 * Register Empty interrupt because otherwise it 
@@ -261,27 +347,23 @@ ISR(USART0_UDRE_vect)
 
 ISR(USART0_RX_vect) 
 {
-	/* Read the character - we ignore the possibility of overrun. */
+	/* Read the character. If the UART lost a character before this
+	 * one (because we didn't read it in time) then count it. 
+	 */
 	char c;
-	c = UDR0;
-		
-	if(do_echo && bytes_in_out_buffer < OUTPUT_BUFFER_SIZE) {
-		/* If echoing is enabled and there is output buffer
-		 * space, echo the received character back to the UART.
-		 * (If there is no output buffer space, characters
-		 * will be lost.)
-		 */
-		uart_put_char(c, 0);
+	uint8_t head = input_head;
+	if(UCSR0A & (1<<DOR0)) {
+		input_overruns++;
 	}
+	c = UDR0;
 	
 	/* 
-	 * Check if we have space in our buffer. If not, set the overrun
-	 * flag and throw away the character. (We never clear the 
-	 * overrun flag - it's up to the programmer to check/clear
-	 * this flag if desired.)
+	 * Check if we have space in our buffer. If not, count the overrun
+	 * and throw away the character. (Echoing, if required, happens when
+	 * the character is read from the buffer.)
 	 */
-	if(bytes_in_input_buffer >= INPUT_BUFFER_SIZE) {
-		input_overrun = 1;
+	if((uint8_t)(head - input_tail) >= INPUT_BUFFER_SPACE) {
+		input_overruns++;
 	} else {
 		/* If the character is a carriage return, turn it into a
 		 * linefeed 
@@ -293,11 +375,7 @@ ISR(USART0_RX_vect)
 		/* 
 		 * There is room in the input buffer 
 		 */
-		input_buffer[input_insert_pos++] = c;
-		bytes_in_input_buffer++;
-		if(input_insert_pos == INPUT_BUFFER_SIZE) {
-			/* Wrap around buffer pointer if necessary */
-			input_insert_pos = 0;
-		}
+		input_buffer[head & INPUT_BUFFER_MASK] = c;
+		input_head = head + 1;
 	}
 }
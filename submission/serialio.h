@@ -36,4 +36,45 @@ int8_t serial_input_available(void);
  */
 void clear_serial_input_buffer(void);
 
+/* Read up to length characters from the serial port into buffer. 
+ * Returns the number of characters read - this is 0 if no input is
+ * available. Never waits for input.
+ */
+uint8_t serial_read(char* buffer, uint8_t length);
+
+/* Write up to length characters from buffer to the serial port. 
+ * Returns the number of characters written - this is less than length
+ * if the output buffer fills (the rest are discarded). Never waits for 
+ * room in the buffer. (Unlike stdio output, \n is not turned into 
+ * \r\n.)
+ */
+uint8_t serial_write(const char* buffer, uint8_t length);
+
+/* Return the number of input characters lost because they weren't read
+ * in time, and the number of output characters discarded because the 
+ * output buffer was full.
+ */
+uint16_t serial_input_overruns(void);
+uint16_t serial_output_overruns(void);
+
+/* Binary mode. In binary mode all text output (stdio, serial_write() 
+ * and echoing) is discarded so that the only output is frames sent by 
+ * serial_write_frame() - for use by programs rather than a terminal.
+ * Text mode is the default.
+ */
+void serial_set_binary(int8_t binary);
+int8_t serial_is_binary(void);
+
+/* Write a binary frame to the serial port. A frame is
+ *   SERIAL_FRAME_SYNC, type, length, length payload bytes, checksum
+ * where the checksum makes the sum of all the bytes after the sync 
+ * byte zero (modulo 256). The frame is written all in one go or not at
+ * all - returns 1 if it was written and 0 if there wasn't room for it
+ * in the output buffer. Never waits. payload may be at most 
+ * SERIAL_FRAME_MAX_PAYLOAD bytes.
+ */
+#define SERIAL_FRAME_SYNC 0xA5
+#define SERIAL_FRAME_MAX_PAYLOAD 64
+int8_t serial_write_frame(uint8_t type, const uint8_t* payload, uint8_t length);
+
 #endif /* SERIALIO_H_ */
\ No newline at end of file
@@ -0,0 +1,146 @@
+/*
+ * sound.c
+ *
+ * Author: Alex Patapan
+ *
+ * Timer 1 generates the note - it counts at 1MHz in fast PWM mode with
+ * OCR1A setting the period and OCR1B the pulse width (half the period).
+ * The buzzer is silenced by making pin D4 an input.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include "sound.h"
+#include "memory.h"
+
+// A note - the timer 1 period (in microseconds, 0 for a rest) and how 
+// long it plays for (in milliseconds). A note with a duration of 0 ends
+// a sequence.
+typedef struct {
+	uint16_t period;
+	uint16_t duration;
+} Note;
+
+#define PERIOD(frequency) (1000000UL / (frequency))
+#define REST 0
+#define END { 0, 0 }
+
+static const Note shoot_notes[] PROGMEM = {
+	{ PERIOD(3000), 100 }, END };
+static const Note hit_notes[] PROGMEM = {
+	{ PERIOD(1200), 100 }, END };
+static const Note basehit_notes[] PROGMEM = {
+	{ PERIOD(500), 181 }, { PERIOD(350), 415 }, { PERIOD(200), 100 }, END };
+static const Note startup_notes[] PROGMEM = {
+	{ PERIOD(500), 93 }, { PERIOD(800), 57 }, { PERIOD(1500), 170 }, 
+	{ PERIOD(2000), 345 }, { PERIOD(2500), 100 }, END };
+static const Note game_over_notes[] PROGMEM = {
+	{ PERIOD(400), 150 }, { PERIOD(300), 150 }, { PERIOD(200), 150 }, 
+	{ REST, 50 }, { PERIOD(100), 400 }, END };
+
+// The notes for each sound effect (in SoundId order). A sound effect's 
+// importance is its position in this list.
+static const Note* const sounds[NUM_SOUNDS] PROGMEM = {
+	shoot_notes, hit_notes, basehit_notes, startup_notes, game_over_notes };
+
+// The note being played (0 if none), the time (ms) it has left to play
+// and which sound effect it is part of. These are changed by the timer0
+// interrupt handler.
+static const Note* volatile current_note;
+static volatile uint16_t time_left;
+static volatile SoundId current_sound;
+
+#define SOUND_SWITCH_ON() (PIND & (1<<3))
+
+// Static data used by this module (see memory.h)
+MEMORY_USAGE(sound, sizeof(current_note) + sizeof(time_left) + 
+		sizeof(current_sound), sizeof(shoot_notes) + sizeof(hit_notes) + 
+		sizeof(basehit_notes) + sizeof(startup_notes) + sizeof(game_over_notes) +
+		sizeof(sounds));
+
+static void start_note(const Note* note);
+static void silence(void);
+
+void init_sound(void) {
+	silence();
+	current_note = 0;
+}
+
+void sound_trigger(SoundId sound) {
+	if(!SOUND_SWITCH_ON()) {
+		return;
+	}
+	
+	// Turn interrupts off so that the interrupt handler doesn't step
+	// through the old sound effect while we start the new one
+	uint8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	if(!current_note || sound >= current_sound) {
+		current_sound = sound;
+		start_note((const Note*)pgm_read_word(&sounds[sound]));
+	}
+	if(interrupts_were_enabled) {
+		sei();
+	}
+}
+
+void sound_stop(void) {
+	uint8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	current_note = 0;
+	silence();
+	if(interrupts_were_enabled) {
+		sei();
+	}
+}
+
+void sound_tick(void) {
+	if(!current_note) {
+		return;
+	}
+	if(!SOUND_SWITCH_ON()) {
+		// Sound has been switched off
+		current_note = 0;
+		silence();
+	} else if(--time_left == 0) {
+		start_note(current_note + 1);
+	}
+}
+
+// Start playing the given note (or stop if it's the end of the 
+// sequence)
+static void start_note(const Note* note) {
+	uint16_t period = pgm_read_word(&note->period);
+	
+	time_left = pgm_read_word(&note->duration);
+	if(time_left == 0) {
+		current_note = 0;
+		silence();
+		return;
+	}
+	current_note = note;
+	if(period == REST) {
+		silence();
+		return;
+	}
+	
+	// Set the maximum count value for timer/counter 1 to be one less 
+	// than the period and the count compare value to one less than
+	// the pulse width (50% duty cycle)
+	OCR1A = period - 1;
+	OCR1B = period / 2 - 1;
+	
+	// Fast PWM, reset to 0 on OCR1A. Count at 1MHz (CLK/8)
+	// OC1B clears on compare match, set on timer overflow (non-inverting)
+	TCCR1A = (1 << COM1B1) | (1 << WGM11) | (1 << WGM10);
+	TCCR1B = (1 << WGM13) | (1 << WGM12) | (1 << CS11);
+	
+	// Make pin D4 (OC1B) an output so the buzzer sounds
+	DDRD |= (1<<4);
+}
+
+static void silence(void) {
+	DDRD &= ~(1<<4);
+}
@@ -0,0 +1,43 @@
+/*
+ * sound.h
+ *
+ * Author: Alex Patapan
+ *
+ * Sound effects are played on the piezo buzzer (pin D4, driven by 
+ * timer 1) in the background. Each effect is a sequence of notes which
+ * the timer0 interrupt handler steps through. Only one effect plays at 
+ * a time - a new effect replaces the one playing unless the one playing
+ * is more important. Sound is only played if the sound switch (pin D3)
+ * is on.
+ */
+
+#ifndef SOUND_H_
+#define SOUND_H_
+
+#include <stdint.h>
+
+// Sound effects, least important first
+typedef enum {
+	SOUND_SHOOT,
+	SOUND_HIT,
+	SOUND_BASEHIT,
+	SOUND_STARTUP,
+	SOUND_GAME_OVER,
+	NUM_SOUNDS
+} SoundId;
+
+// Set up the buzzer (silent)
+void init_sound(void);
+
+// Start playing the given sound effect (unless a more important one is 
+// playing or the sound switch is off)
+void sound_trigger(SoundId sound);
+
+// Stop any sound effect which is playing
+void sound_stop(void);
+
+// Advance the sound effect being played by one millisecond. Called from
+// the timer0 interrupt handler.
+void sound_tick(void);
+
+#endif /* SOUND_H_ */
@@ -5,7 +5,85 @@
  */ 
 
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include "spi.h"
+#include "memory.h"
+
+/* Transmit queue. Bytes are added at queue_head by the main program and
+ * removed from queue_tail by the SPI transfer complete interrupt handler.
+ * The indices are free running (they wrap naturally at 256) so the number
+ * of bytes waiting is always queue_head - queue_tail. SPI_QUEUE_SIZE must 
+ * be a power of two.
+ * spi_busy is 1 while a transfer is in progress - if it is 0 the next
+ * byte queued must be written to SPDR0 to get the interrupts going again.
+ */
+#define SPI_QUEUE_SIZE 64
+#define SPI_QUEUE_MASK (SPI_QUEUE_SIZE - 1)
+static volatile uint8_t spi_queue[SPI_QUEUE_SIZE];
+static volatile uint8_t queue_head;
+static volatile uint8_t queue_tail;
+static volatile uint8_t spi_busy;
+
+/* Queued setting changes - the clock divider and selected device. Each
+ * takes effect when the transmit queue tail reaches the queue head at 
+ * the time the change was queued, i.e. once the bytes queued before 
+ * the change have been sent. setting_head and setting_tail work as for
+ * the transmit queue. queued_setting is the setting that newly queued 
+ * bytes will be sent with.
+ * A setting is the clock divider bits (SETTING_CLOCK_MASK) and the
+ * device number (shifted by SETTING_DEVICE_SHIFT).
+ */
+#define SETTING_QUEUE_SIZE 8
+#define SETTING_QUEUE_MASK (SETTING_QUEUE_SIZE - 1)
+static volatile uint8_t setting_position[SETTING_QUEUE_SIZE];
+static volatile uint8_t setting_value[SETTING_QUEUE_SIZE];
+static volatile uint8_t setting_head;
+static volatile uint8_t setting_tail;
+static uint8_t queued_setting;
+
+#define SETTING_SPR0 (1<<0)
+#define SETTING_SPR1 (1<<1)
+#define SETTING_2X (1<<2)
+#define SETTING_CLOCK_MASK (SETTING_SPR0|SETTING_SPR1|SETTING_2X)
+#define SETTING_DEVICE_SHIFT 3
+#define SETTING_DEVICE_MASK (3<<SETTING_DEVICE_SHIFT)
+
+/* Pacing (see spi_set_pacing()). pacing_tokens is the number of bytes
+ * that may be sent before waiting for the next tick. spi_stalled is 1
+ * if there are bytes waiting but no tokens left - in that case no 
+ * transfer is in progress and the next tick starts one.
+ */
+static uint8_t pacing_burst;
+static uint8_t pacing_rate;
+static volatile uint8_t pacing_tokens;
+static volatile uint8_t spi_stalled;
+
+#if SPI_NUM_DEVICES > 3
+#error "Only 3 SPI devices are supported"
+#endif
+
+/* Slave select pins. Device 0 uses the SS pin (port B pin 4), devices
+ * 1 and 2 use port A pins 6 and 7 (the rest of port A is used by the
+ * joystick and the lives LEDs). Select lines are active low.
+ */
+#define DEVICE_1_PIN 6
+#define DEVICE_2_PIN 7
+
+/* Static data used by this module (see memory.h) */
+MEMORY_USAGE(spi, sizeof(spi_queue) + sizeof(queue_head) + sizeof(queue_tail) +
+		sizeof(spi_busy) + sizeof(setting_position) + sizeof(setting_value) +
+		sizeof(setting_head) + sizeof(setting_tail) + sizeof(queued_setting) +
+		sizeof(pacing_burst) + sizeof(pacing_rate) + sizeof(pacing_tokens) +
+		sizeof(spi_stalled), 0);
+
+static uint8_t clock_setting(uint8_t clockdivider);
+static void queue_setting(uint8_t setting);
+static void apply_setting(uint8_t setting);
+static void send_next_byte(void);
+static void service_queue_polled(void);
+#if SPI_NUM_DEVICES > 1
+static void select(uint8_t device);
+#endif
 
 void spi_setup_master(uint8_t clockdivider) {
 	// Set up SPI communication as a master
@@ -16,54 +94,294 @@ void spi_setup_master(uint8_t clockdivider) {
 	
 	// Set the slave select (SS) line high
 	PORTB |= (1<<4);
+#if SPI_NUM_DEVICES > 1
+	// and the select lines of the other devices
+	DDRA |= (1<<DEVICE_1_PIN)|(1<<DEVICE_2_PIN);
+	PORTA |= (1<<DEVICE_1_PIN)|(1<<DEVICE_2_PIN);
+#endif
 	
 	// Set up the SPI control registers SPCR and SPSR:
 	// - SPE bit = 1 (SPI is enabled)
 	// - MSTR bit = 1 (Master Mode)
-	SPCR0 = (1<<SPE0)|(1<<MSTR0);
+	// - SPIE bit = 1 (Interrupt on transfer complete - see below)
+	// and the clock divider bits (see apply_setting())
+	SPCR0 = (1<<SPE0)|(1<<MSTR0)|(1<<SPIE0);
+	queued_setting = clock_setting(clockdivider);
+	apply_setting(queued_setting);
+	
+	// Take SS (slave select) line low
+	PORTB &= ~(1<<4);
+	
+	// Empty the transmit queue and turn pacing off
+	queue_head = 0;
+	queue_tail = 0;
+	spi_busy = 0;
+	setting_head = 0;
+	setting_tail = 0;
+	pacing_rate = 0;
+	spi_stalled = 0;
+}
+
+void spi_queue_clock(uint8_t clockdivider) {
+	queue_setting((queued_setting & ~SETTING_CLOCK_MASK) | 
+			clock_setting(clockdivider));
+}
+
+void spi_set_pacing(uint8_t burst, uint8_t bytes_per_ms) {
+	uint8_t interrupts_enabled = bit_is_set(SREG, SREG_I);
+	
+	cli();
+	pacing_burst = burst;
+	pacing_rate = bytes_per_ms;
+	pacing_tokens = burst;
+	if(spi_stalled) {
+		// Carry on with the new limit
+		spi_stalled = 0;
+		send_next_byte();
+	}
+	if(interrupts_enabled) {
+		sei();
+	}
+}
+
+void spi_pacing_tick(void) {
+	if(pacing_rate == 0) {
+		return;
+	}
+	if((uint16_t)pacing_tokens + pacing_rate >= pacing_burst) {
+		pacing_tokens = pacing_burst;
+	} else {
+		pacing_tokens += pacing_rate;
+	}
+	if(spi_stalled) {
+		spi_stalled = 0;
+		send_next_byte();
+	}
+}
+
+uint8_t spi_send_byte(uint8_t byte) {
+	uint8_t received;
+	
+	// Make sure the queue is empty and turn off the transfer complete
+	// interrupt so the interrupt handler doesn't intervene
+	spi_drain();
+	SPCR0 &= ~(1<<SPIE0);
+	
+	// Write out the byte to the SPDR0 register. This will initiate
+	// the transfer. We then wait until the most significant byte of
+	// SPSR0 (SPIF0 bit) is set - this indicates that the transfer is
+	// complete. (The final read of SPSR0 followed by a read of SPDR0
+	// will cause the SPIF bit to be reset to 0. See page 173 of the 
+	// ATmega324A datasheet.)
+	SPDR0 = byte;
+	while((SPSR0 & (1<<SPIF0)) == 0) {
+		; // wait
+	}
+	received = SPDR0;
+	SPCR0 |= (1<<SPIE0);
+	return received;
+}
+
+void spi_queue_byte(uint8_t byte) {
+	uint8_t interrupts_enabled = bit_is_set(SREG, SREG_I);
+	
+	// Wait until there is room in the queue. If interrupts are
+	// disabled then the interrupt handler won't empty the queue for
+	// us so we send the next byte ourselves.
+	while((uint8_t)(queue_head - queue_tail) >= SPI_QUEUE_SIZE) {
+		if(!interrupts_enabled) {
+			service_queue_polled();
+		}
+	}
+	
+	// Add the byte to the queue and, if no transfer is in progress,
+	// start one. Interrupts are disabled while we do this so the 
+	// interrupt handler can't finish the current transfer part way 
+	// through.
+	cli();
+	spi_queue[queue_head & SPI_QUEUE_MASK] = byte;
+	queue_head++;
+	if(!spi_busy) {
+		spi_busy = 1;
+		send_next_byte();
+	}
+	if(interrupts_enabled) {
+		sei();
+	}
+}
+
+void spi_queue_bytes(const uint8_t* bytes, uint8_t length) {
+	while(length--) {
+		spi_queue_byte(*bytes++);
+	}
+}
+
+void spi_queue_select(uint8_t device) {
+	if(device < SPI_NUM_DEVICES) {
+		queue_setting((queued_setting & ~SETTING_DEVICE_MASK) | 
+				(device << SETTING_DEVICE_SHIFT));
+	}
+}
+
+void spi_drain(void) {
+	while(spi_busy) {
+		if(!bit_is_set(SREG, SREG_I)) {
+			service_queue_polled();
+		}
+	}
+}
+
+/* Return the setting bits for the given clock divider. These are the 
+ * values of the SPR0 and SPR1 bits in SPCR and the SPI2X bit in SPSR.
+ * Invalid values default to the slowest speed.
+ */
+static uint8_t clock_setting(uint8_t clockdivider) {
+	uint8_t setting = 0;
 	
-	// Set SPR0 and SPR1 bits in SPCR and SPI2X bit in SPSR
-	// based on the given clock divider
-	// Invalid values default to the slowest speed
 	// We consider each bit in turn
 	switch(clockdivider) {
 		case 2:
 		case 8:
 		case 32:
-			SPSR0 = (1<<SPI2X0);
-			break;
-		default:
-			SPSR0 = 0;
+			setting = SETTING_2X;
 			break;
 	}
 	switch(clockdivider) {
-		case 128:
-			SPCR0 |= (1<<SPR00);
-			// Note this flows through to the next code block
+		case 2:
+		case 4:
+			break;
 		case 32:
 		case 64:
-			SPCR0 |= (1<<SPR10);
+			setting |= SETTING_SPR1;
 			break;
 		case 8:
 		case 16:
-			SPCR0 |= (1<<SPR00);
+			setting |= SETTING_SPR0;
+			break;
+		default:
+			setting |= SETTING_SPR0|SETTING_SPR1;
 			break;
 	}
+	return setting;
+}
+
+/* Queue a change to the given setting (see spi_queue_select()).
+ */
+static void queue_setting(uint8_t setting) {
+	uint8_t interrupts_enabled = bit_is_set(SREG, SREG_I);
+	uint8_t last = (setting_head - 1) & SETTING_QUEUE_MASK;
 	
-	// Take SS (slave select) line low
-	PORTB &= ~(1<<4);
+	if(setting == queued_setting) {
+		return;
+	}
+	// Wait for room in the queue of changes (as in spi_queue_byte())
+	while((uint8_t)(setting_head - setting_tail) >= SETTING_QUEUE_SIZE) {
+		if(!interrupts_enabled) {
+			service_queue_polled();
+		}
+	}
+	cli();
+	if(!spi_busy) {
+		// Nothing is being sent - change straight away
+		apply_setting(setting);
+	} else if(setting_head != setting_tail && 
+			setting_position[last] == queue_head) {
+		// No bytes have been queued since the last change - replace it
+		setting_value[last] = setting;
+	} else {
+		setting_position[setting_head & SETTING_QUEUE_MASK] = queue_head;
+		setting_value[setting_head & SETTING_QUEUE_MASK] = setting;
+		setting_head++;
+	}
+	queued_setting = setting;
+	if(interrupts_enabled) {
+		sei();
+	}
 }
 
-uint8_t spi_send_byte(uint8_t byte) {
-	// Write out the byte to the SPDR0 register. This will initiate
-	// the transfer. We then wait until the most significant byte of
-	// SPSR0 (SPIF0 bit) is set - this indicates that the transfer is
-	// complete. (The final read of SPSR0 followed by a read of SPDR0
-	// will cause the SPIF bit to be reset to 0. See page 173 of the 
-	// ATmega324A datasheet.)
-	SPDR0 = byte;
-	while((SPSR0 & (1<<SPIF0)) == 0) {
-		; // wait
+/* Set the clock divider and select the device given by the setting. 
+ * This must only be done between transfers.
+ */
+static void apply_setting(uint8_t setting) {
+	SPCR0 &= ~((1<<SPR10)|(1<<SPR00));
+	if(setting & SETTING_SPR0) {
+		SPCR0 |= (1<<SPR00);
+	}
+	if(setting & SETTING_SPR1) {
+		SPCR0 |= (1<<SPR10);
+	}
+	SPSR0 = (setting & SETTING_2X) ? (1<<SPI2X0) : 0;
+#if SPI_NUM_DEVICES > 1
+	select(setting >> SETTING_DEVICE_SHIFT);
+#endif
+}
+
+/* Used when interrupts are disabled - wait for the current transfer to
+ * complete and then do what the interrupt handler would have done.
+ */
+static void service_queue_polled(void) {
+	if(spi_stalled) {
+		// The timer interrupt can't allow more bytes while interrupts
+		// are disabled, so we don't pace bytes sent from here
+		spi_stalled = 0;
+		pacing_tokens = 1;
+	} else {
+		while((SPSR0 & (1<<SPIF0)) == 0) {
+			; // wait
+		}
+		(void)SPDR0;
+	}
+	send_next_byte();
+}
+
+/* The last byte has been sent (or has been allowed by pacing) - make 
+ * any setting changes that are due and send the next byte in the queue
+ * (if any).
+ */
+static void send_next_byte(void) {
+	while(setting_head != setting_tail && 
+			setting_position[setting_tail & SETTING_QUEUE_MASK] == queue_tail) {
+		apply_setting(setting_value[setting_tail & SETTING_QUEUE_MASK]);
+		setting_tail++;
 	}
-	return SPDR0;
-}
\ No newline at end of file
+	if(queue_head == queue_tail) {
+		spi_busy = 0;
+	} else if(pacing_rate && pacing_tokens == 0) {
+		// Wait for spi_pacing_tick()
+		spi_stalled = 1;
+	} else {
+		if(pacing_rate) {
+			pacing_tokens--;
+		}
+		SPDR0 = spi_queue[queue_tail & SPI_QUEUE_MASK];
+		queue_tail++;
+	}
+}
+
+#if SPI_NUM_DEVICES > 1
+/* Take the select line of the given device low and the others high.
+ */
+static void select(uint8_t device) {
+	PORTB |= (1<<4);
+	PORTA |= (1<<DEVICE_1_PIN)|(1<<DEVICE_2_PIN);
+	switch(device) {
+		case 0:
+			PORTB &= ~(1<<4);
+			break;
+		case 1:
+			PORTA &= ~(1<<DEVICE_1_PIN);
+			break;
+		case 2:
+			PORTA &= ~(1<<DEVICE_2_PIN);
+			break;
+	}
+}
+#endif
+
+/* Interrupt handler for SPI transfer complete. We send the next byte 
+ * in the queue (if any). (The SPIF flag is cleared by hardware when
+ * this handler is executed.)
+ */
+ISR(SPI_STC_vect) {
+	send_next_byte();
+}
@@ -7,12 +7,57 @@
 #ifndef SPI_H_
 #define SPI_H_
 
+#include <stdint.h>
+
+// Number of SPI slave devices (each with its own slave select line - 
+// see spi.c for the pins used). At most 3.
+#ifndef SPI_NUM_DEVICES
+#define SPI_NUM_DEVICES 1
+#endif
+
 // Set up SPI communication as a master.
 // clockdivider should be one of 2,4,8,16,32,64,128
 void spi_setup_master(uint8_t clockdivider);
 
+// Change the clock divider used for the bytes queued from now on. As
+// with spi_queue_select() the change takes effect once the bytes 
+// already queued have been sent, so different kinds of transfer can 
+// be sent at different speeds.
+void spi_queue_clock(uint8_t clockdivider);
+
+// Limit the rate at which queued bytes are sent. Bytes are sent at the
+// full clock rate in bursts of up to burst bytes, after which they are
+// sent at bytes_per_ms bytes per millisecond (on average) until the
+// queue has been idle long enough to build up a full burst again. 
+// This lets a fast clock be used for a device which can only keep up
+// with a slower one for more than a few bytes. A bytes_per_ms of 0 
+// turns the limit off (the default). The limit doesn't apply while 
+// interrupts are disabled or to spi_send_byte().
+void spi_set_pacing(uint8_t burst, uint8_t bytes_per_ms);
+
+// Called every millisecond (from the timer0 interrupt handler) to 
+// allow more bytes to be sent when pacing.
+void spi_pacing_tick(void);
+
 // Send and receive an SPI byte. This function will take at least 8 
-// cyles of the divided clock (i.e. will busy wait).
+// cyles of the divided clock (i.e. will busy wait). Any bytes waiting
+// in the transmit queue (below) are sent first.
 uint8_t spi_send_byte(uint8_t byte);
 
-#endif /* SPI_H_ */
\ No newline at end of file
+// Queue bytes for transmission. The bytes are sent by the SPI
+// interrupt handler so these functions return straight away unless
+// the queue is full, in which case they wait until there is room.
+// (Received bytes are discarded.)
+void spi_queue_byte(uint8_t byte);
+void spi_queue_bytes(const uint8_t* bytes, uint8_t length);
+
+// Select the device that the bytes queued from now on are sent to.
+// The change takes effect once the bytes already queued have been 
+// sent, so this doesn't wait (unless a lot of changes are queued). 
+// Device 0 is selected initially.
+void spi_queue_select(uint8_t device);
+
+// Wait until all queued bytes have been sent.
+void spi_drain(void);
+
+#endif /* SPI_H_ */
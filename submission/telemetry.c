@@ -0,0 +1,138 @@
+/*
+ * telemetry.c
+ *
+ * Author: Alex Patapan
+ *
+ * We keep the current value of each field and the value last sent. 
+ * A field goes in a frame if they differ (or if every field has to be 
+ * sent) and the last sent values are only updated once the frame has 
+ * been accepted by serialio.
+ */
+
+#include <stdint.h>
+
+#include "telemetry.h"
+#include "serialio.h"
+#include "profiler.h"
+#include "timer0.h"
+#include "memory.h"
+
+#if 5 + PROF_NUM_SECTIONS > 16
+#error "Too many telemetry fields for the 16 bit field mask"
+#endif
+
+// Largest payload - the mask, score, lives, period, state, input and 
+// the profiler counts
+#define MAX_PAYLOAD	(2 + 4 + 1 + 2 + 1 + 2 + 2 * PROF_NUM_SECTIONS)
+
+typedef struct {
+	uint32_t score;
+	int8_t lives;
+	uint16_t period;
+	uint8_t state;
+	uint16_t profile[PROF_NUM_SECTIONS];
+} TelemetryValues;
+
+static TelemetryValues current;
+static TelemetryValues sent;
+static uint16_t input;
+static uint8_t send_all;
+static uint32_t last_frame_time;
+
+// Static data used by this module (see memory.h)
+MEMORY_USAGE(telemetry, sizeof(current) + sizeof(sent) + sizeof(input) +
+		sizeof(send_all) + sizeof(last_frame_time), 0);
+
+static uint8_t* put_bytes(uint8_t* p, uint32_t value, uint8_t length);
+
+void telemetry_init(void) {
+	send_all = 1;
+	input = 0;
+}
+
+void telemetry_set_score(uint32_t score) {
+	current.score = score;
+}
+
+void telemetry_set_lives(int8_t lives) {
+	current.lives = lives;
+}
+
+void telemetry_set_period(uint16_t period) {
+	current.period = period;
+}
+
+void telemetry_set_state(uint8_t state) {
+	current.state = state;
+}
+
+void telemetry_input(uint16_t actions) {
+	input |= actions;
+}
+
+void telemetry_flush(void) {
+	uint8_t payload[MAX_PAYLOAD];
+	uint8_t* p = payload + 2;
+	uint16_t fields = 0;
+	uint32_t now;
+	
+	if(!serial_is_binary()) {
+		return;
+	}
+	now = get_current_time();
+	if(now - last_frame_time < TELEMETRY_PERIOD) {
+		return;
+	}
+	
+	for(uint8_t i=0; i < PROF_NUM_SECTIONS; i++) {
+		current.profile[i] = profile_count(i);
+	}
+	if(send_all || current.score != sent.score) {
+		fields |= TELEMETRY_FIELD_SCORE;
+		p = put_bytes(p, current.score, 4);
+	}
+	if(send_all || current.lives != sent.lives) {
+		fields |= TELEMETRY_FIELD_LIVES;
+		p = put_bytes(p, (uint8_t)current.lives, 1);
+	}
+	if(send_all || current.period != sent.period) {
+		fields |= TELEMETRY_FIELD_PERIOD;
+		p = put_bytes(p, current.period, 2);
+	}
+	if(send_all || current.state != sent.state) {
+		fields |= TELEMETRY_FIELD_STATE;
+		p = put_bytes(p, current.state, 1);
+	}
+	if(input) {
+		fields |= TELEMETRY_FIELD_INPUT;
+		p = put_bytes(p, input, 2);
+	}
+	for(uint8_t i=0; i < PROF_NUM_SECTIONS; i++) {
+		if(send_all || current.profile[i] != sent.profile[i]) {
+			fields |= TELEMETRY_FIELD_PROFILE(i);
+			p = put_bytes(p, current.profile[i], 2);
+		}
+	}
+	
+	// Nothing has changed - wait until something does
+	if(fields == 0) {
+		return;
+	}
+	put_bytes(payload, fields, 2);
+	if(serial_write_frame(TELEMETRY_STATE_FRAME, payload, p - payload)) {
+		sent = current;
+		input = 0;
+		send_all = 0;
+		last_frame_time = now;
+	}
+}
+
+// Store the low length bytes of value at p (little endian) and return
+// the position after them
+static uint8_t* put_bytes(uint8_t* p, uint32_t value, uint8_t length) {
+	while(length--) {
+		*p++ = (uint8_t)value;
+		value >>= 8;
+	}
+	return p;
+}
@@ -0,0 +1,63 @@
+/*
+ * telemetry.h
+ *
+ * Author: Alex Patapan
+ *
+ * Binary telemetry for external tools (see serial_write_frame()). The
+ * game state is recorded as it changes and, while the serial port is 
+ * in binary mode, telemetry_flush() sends a TELEMETRY_STATE_FRAME at
+ * most every TELEMETRY_PERIOD milliseconds with just the values which
+ * have changed since the last frame sent.
+ *
+ * The payload of a TELEMETRY_STATE_FRAME is a 16 bit mask of the 
+ * fields present (TELEMETRY_FIELD_SCORE etc.) followed by those fields
+ * in order. Multi-byte values are little endian.
+ *	SCORE		score (32 bits)
+ *	LIVES		lives (8 bits, signed)
+ *	PERIOD		asteroid tick period in ms (16 bits)
+ *	STATE		game state (8 bits - see GameState in project.c)
+ *	INPUT		input actions since the last frame (16 bits, ACTION_LEFT 
+ *				etc. ORed together)
+ *	PROFILE(s)	number of times profiler section s has run (16 bits) - 
+ *				one field for each section
+ * If a frame doesn't fit in the serial output buffer it is dropped and
+ * its changes are sent in the next frame instead.
+ */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <stdint.h>
+
+#ifndef TELEMETRY_PERIOD
+#define TELEMETRY_PERIOD 100
+#endif
+
+// Frame types
+#define TELEMETRY_STATE_FRAME	0x01
+
+// Fields of a TELEMETRY_STATE_FRAME
+#define TELEMETRY_FIELD_SCORE		(1<<0)
+#define TELEMETRY_FIELD_LIVES		(1<<1)
+#define TELEMETRY_FIELD_PERIOD		(1<<2)
+#define TELEMETRY_FIELD_STATE		(1<<3)
+#define TELEMETRY_FIELD_INPUT		(1<<4)
+#define TELEMETRY_FIELD_PROFILE(s)	(1<<(5 + (s)))
+
+// Forget what has been sent - the next frame sends every field
+void telemetry_init(void);
+
+// Record new values to be sent
+void telemetry_set_score(uint32_t score);
+void telemetry_set_lives(int8_t lives);
+void telemetry_set_period(uint16_t period);
+void telemetry_set_state(uint8_t state);
+
+// Record input actions (which are sent once and then cleared)
+void telemetry_input(uint16_t actions);
+
+// Send a frame of the changes if we're in binary mode and at least
+// TELEMETRY_PERIOD ms have passed since the last one. Never waits.
+void telemetry_flush(void);
+
+#endif /* TELEMETRY_H_ */
@@ -0,0 +1,125 @@
+/*
+ * terminal_status.c
+ *
+ * Author: Alex Patapan
+ *
+ * The score is right aligned so that its last digit is always in
+ * SCORE_END_X, with the "Score: " label immediately before it. The
+ * lives value is a single digit after the "Lives: " label.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <avr/pgmspace.h>
+
+#include "terminal_status.h"
+#include "terminalio.h"
+#include "intmath.h"
+#include "memory.h"
+
+#define SCORE_Y			12
+#define SCORE_END_X		18
+#define LIVES_Y			13
+#define LIVES_X			10
+#define LABEL_LENGTH	7
+
+#define MAX_SCORE_DIGITS U32_MAX_DIGITS
+
+/* Values to be displayed */
+static uint32_t score;
+static int8_t lives;
+static uint8_t changed;
+
+/* What is currently shown on the terminal. shown_score_length is 0
+ * and shown_lives is -1 if nothing is shown.
+ */
+static char shown_score[MAX_SCORE_DIGITS];
+static uint8_t shown_score_length;
+static int8_t shown_lives;
+
+// Static data used by this module (see memory.h)
+MEMORY_USAGE(terminal_status, sizeof(score) + sizeof(lives) + sizeof(changed) +
+		sizeof(shown_score) + sizeof(shown_score_length) + sizeof(shown_lives), 0);
+
+void terminal_status_init(void) {
+	shown_score_length = 0;
+	shown_lives = -1;
+	changed = 1;
+}
+
+void terminal_status_set_score(uint32_t new_score) {
+	if(new_score != score) {
+		score = new_score;
+		changed = 1;
+	}
+}
+
+void terminal_status_set_lives(int8_t new_lives) {
+	// We only have room for a single digit
+	if(new_lives < 0) {
+		new_lives = 0;
+	} else if(new_lives > 9) {
+		new_lives = 9;
+	}
+	if(new_lives != lives) {
+		lives = new_lives;
+		changed = 1;
+	}
+}
+
+void terminal_status_flush(void) {
+	char digits[MAX_SCORE_DIGITS + 1];
+	uint8_t length, i;
+	uint8_t hide = 0;
+	
+	if(!changed) {
+		return;
+	}
+	changed = 0;
+	
+	length = format_u32(score, digits);
+	if(length != shown_score_length) {
+		// The label moves when the number of digits changes - rewrite 
+		// the whole line (blanking anything left over from a longer
+		// number that was shown before)
+		i = (length > shown_score_length) ? length : shown_score_length;
+		move_cursor(SCORE_END_X - LABEL_LENGTH - i + 1, SCORE_Y);
+		for(; i > length; i--) {
+			putchar(' ');
+		}
+		fputs_P(PSTR("Score: "), stdout);
+		i = 0;
+		hide = 1;
+	} else {
+		// Find the first digit which has changed and rewrite from there
+		for(i=0; i < length && digits[i] == shown_score[i]; i++) {
+			;
+		}
+		if(i < length) {
+			move_cursor(SCORE_END_X - length + i + 1, SCORE_Y);
+			hide = 1;
+		}
+	}
+	for(; i < length; i++) {
+		putchar(digits[i]);
+		shown_score[i] = digits[i];
+	}
+	shown_score_length = length;
+	
+	if(lives != shown_lives) {
+		if(shown_lives < 0) {
+			move_cursor(LIVES_X, LIVES_Y);
+			fputs_P(PSTR("Lives: "), stdout);
+		} else {
+			move_cursor(LIVES_X + LABEL_LENGTH, LIVES_Y);
+		}
+		putchar('0' + lives);
+		shown_lives = lives;
+		hide = 1;
+	}
+	
+	if(hide) {
+		hide_cursor();
+	}
+}
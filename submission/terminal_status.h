@@ -0,0 +1,33 @@
+/*
+ * terminal_status.h
+ *
+ * Author: Alex Patapan
+ *
+ * Keeps the score and lives lines on the serial terminal up to date.
+ * The values shown are cached so that when they change only the digits
+ * that differ are rewritten. Updates are recorded straight away but 
+ * are only output to the terminal when terminal_status_flush() is 
+ * called, so several changes in one frame result in a single write.
+ */
+
+#ifndef TERMINAL_STATUS_H_
+#define TERMINAL_STATUS_H_
+
+#include <stdint.h>
+
+/* Forget what is shown on the terminal - the next flush will output
+ * the whole status. This should be called after the terminal is
+ * cleared.
+ */
+void terminal_status_init(void);
+
+/* Record new values to be displayed.
+ */
+void terminal_status_set_score(uint32_t score);
+void terminal_status_set_lives(int8_t lives);
+
+/* Output any changes to the terminal since the last flush.
+ */
+void terminal_status_flush(void);
+
+#endif /* TERMINAL_STATUS_H_ */
@@ -10,9 +10,20 @@
 #include <avr/pgmspace.h>
 
 #include "terminalio.h"
+#include "intmath.h"
 
+/* The cursor is moved often so we format the numbers ourselves
+ * rather than going through printf.
+ */
 void move_cursor(int x, int y) {
-    printf_P(PSTR("\x1b[%d;%dH"), y, x);
+	char number[U32_MAX_DIGITS + 1];
+	fputs_P(PSTR("\x1b["), stdout);
+	format_u32((uint32_t)y, number);
+	fputs(number, stdout);
+	putchar(';');
+	format_u32((uint32_t)x, number);
+	fputs(number, stdout);
+	putchar('H');
 }
 
 void normal_display_mode(void) {
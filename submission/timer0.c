@@ -10,10 +10,12 @@
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
-#include <math.h>
 
 #include "timer0.h"
 #include "score.h"
+#include "sound.h"
+#include "spi.h"
+#include "memory.h"
 
 /* Our internal clock tick count - incremented every 
  * millisecond. Will overflow every ~49 days. */
@@ -75,13 +77,61 @@ uint32_t get_current_time(void) {
 	return returnValue;
 }
 
+uint32_t get_fine_time(void) {
+	uint32_t ticks;
+	uint8_t count;
+	
+	uint8_t interruptsOn = bit_is_set(SREG, SREG_I);
+	cli();
+	ticks = clockTicks;
+	count = TCNT0;
+	if((TIFR0 & (1<<OCF0A)) && count < OCR0A) {
+		/* The counter has been reset but the interrupt handler hasn't
+		 * incremented clockTicks yet. 
+		 */
+		ticks++;
+	}
+	if(interruptsOn) {
+		sei();
+	}
+	return ticks * TIMER0_COUNTS_PER_MS + count;
+}
+
+/* Game time is the clock tick count less the total time it has been
+ * paused for. While paused it stays at the value it had when paused.
+ */
+static uint32_t paused_total;
+static uint32_t pause_start;
+static uint8_t game_time_paused;
+
+uint32_t get_game_time(void) {
+	if(game_time_paused) {
+		return pause_start - paused_total;
+	}
+	return get_current_time() - paused_total;
+}
+
+void pause_game_time(void) {
+	if(!game_time_paused) {
+		pause_start = get_current_time();
+		game_time_paused = 1;
+	}
+}
+
+void resume_game_time(void) {
+	if(game_time_paused) {
+		paused_total += get_current_time() - pause_start;
+		game_time_paused = 0;
+	}
+}
+
 // Seven segment display digit being displayed.
 // 0 = right digit; 1 = left digit.
 volatile uint8_t seven_seg_cc = 0;
 
-// Seven segment display segment values for 0 to 9
-uint8_t seven_segment[10] = {63,6,91,79,102,109,125,7,127,111};
-
+// Static data used by this module (see memory.h)
+MEMORY_USAGE(timer0, sizeof(clockTicks) + sizeof(paused_total) + 
+		sizeof(pause_start) + sizeof(game_time_paused) + sizeof(seven_seg_cc), 0);
 
 ISR(TIMER0_COMPA_vect) {
 	/* Increment our clock tick count */
@@ -90,24 +140,13 @@ ISR(TIMER0_COMPA_vect) {
 	// swap CC
 	seven_seg_cc = 1 ^ seven_seg_cc;
 	
-	// find the score
-	int32_t score = (int32_t) get_score();
+	// output score to SSD - score.c keeps the segment values up
+	// to date whenever the score changes
+	PORTC = score_segments[seven_seg_cc];
 	
-	if (score > 99) {
-		
-		// the SSD is capped at displaying a score of 99 at the max
-		score = 99;
-	}
+	// move the sound effect on
+	sound_tick();
 	
-	// output score to SSD
-	if (seven_seg_cc == 0) {
-		// rightmost digit
-		
-		PORTC = seven_segment[score%10] | (0<<7);	
-	} else if (score > 9) {
-		// leftmost higher digit
-		int digit = (int) floor(score/10);
-		PORTC = seven_segment[digit] | (1<<7);
-		}
-		
+	// let the SPI queue send more bytes (if it is being paced)
+	spi_pacing_tick();
 }
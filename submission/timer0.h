@@ -30,4 +30,25 @@ void init_timer0(void);
  */
 uint32_t get_current_time(void);
 
+/* Return a finer grained time reference - the number of timer counts
+ * since the timer was initialised. Each count is TIMER0_CYCLES_PER_COUNT
+ * clock cycles (8 microseconds) and there are TIMER0_COUNTS_PER_MS counts 
+ * per millisecond. The value wraps around every ~9.5 hours, but the 
+ * difference between two values is valid for intervals shorter than that.
+ * This can be used with interrupts disabled (e.g. in an interrupt handler).
+ */
+#define TIMER0_CYCLES_PER_COUNT 64
+#define TIMER0_COUNTS_PER_MS 125
+uint32_t get_fine_time(void);
+
+/* Game time - milliseconds of the clock tick count during which game
+ * time was running. Pausing game time freezes it (the clock itself, 
+ * and everything driven by the timer interrupt, keeps running) and 
+ * resuming carries on from where it was frozen. Pausing when already
+ * paused or resuming when not paused does nothing.
+ */
+uint32_t get_game_time(void);
+void pause_game_time(void);
+void resume_game_time(void);
+
 #endif
\ No newline at end of file